@@ -27,6 +27,7 @@ public class FirstPersonCharacter : ModuleRules
 			new string[]
 			{
 				"Core",
+				"AIModule",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
@@ -42,9 +43,15 @@ public class FirstPersonCharacter : ModuleRules
 				"InputCore",
 				"GameplayCameras",
 				"PhysicsCore",
+				"AssetRegistry",
+				"TraceLog",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
+
+		// The network tests start multiplayer play in editor sessions
+		if (Target.bBuildEditor)
+			PrivateDependencyModuleNames.Add("UnrealEd");
 		
 		
 		DynamicallyLoadedModuleNames.AddRange(
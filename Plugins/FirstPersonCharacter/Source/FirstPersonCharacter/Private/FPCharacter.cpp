@@ -1,7 +1,17 @@
 // Copyright Ali El Saleh, 2020
 
 #include "FPCharacter.h"
+#include "FirstPersonCharacter.h"
+#include "FirstPersonCharacterMovementComponent.h"
+#include "FirstPersonCharacterStats.h"
+#include "FirstPersonCharacterSubsystem.h"
+#include "FirstPersonCharacterTrace.h"
+#include "FirstPersonFootstepBank.h"
+#include "FirstPersonClearanceSubsystem.h"
+#include "FirstPersonFootstepAudioSubsystem.h"
 #include "FirstPersonFootstepData.h"
+#include "FirstPersonInputProfile.h"
+#include "FirstPersonInputRecorderComponent.h"
 
 #include "Components/InputComponent.h"
 #include "Components/CapsuleComponent.h"
@@ -10,28 +20,64 @@
 
 #include "GameFramework/Controller.h"
 #include "GameFramework/GameUserSettings.h"
-#include "GameFramework/InputSettings.h"
+#include "GameFramework/PlayerController.h"
 #include "GameFramework/SpringArmComponent.h"
 
 #include "Kismet/GameplayStatics.h"
 
+#include "Materials/MaterialInterface.h"
+
+#include "Net/UnrealNetwork.h"
+
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
 #include "Sound/SoundBase.h"
 
+#include "TimerManager.h"
+
 #include "GameplayCameras/Public/MatineeCameraShake.h"
 
-AFPCharacter::AFPCharacter()
+DECLARE_CYCLE_STAT(TEXT("Character Tick"), STAT_FirstPersonCharacterTick, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Update Locomotion"), STAT_FirstPersonUpdateLocomotion, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Crouch Transition"), STAT_CrouchTransition, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Is Blocked In Crouch Stance"), STAT_IsBlockedInCrouchStance, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Update Camera Shake"), STAT_FirstPersonUpdateCameraShake, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Play Footstep Sound"), STAT_PlayFootstepSound, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Get Footstep Sound"), STAT_GetFootstepSound, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Apply Input Bindings"), STAT_ApplyInputBindings, STATGROUP_FirstPersonCharacter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Active Crouch Transitions"), STAT_ActiveCrouchTransitions, STATGROUP_FirstPersonCharacter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crouch Capsule Resizes"), STAT_CrouchCapsuleResizes, STATGROUP_FirstPersonCharacter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Floor Sweeps"), STAT_FootstepFloorSweeps, STATGROUP_FirstPersonCharacter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Floors Found"), STAT_FootstepFloorsFound, STATGROUP_FirstPersonCharacter);
+
+namespace
+{
+	// Mouse deltas are distances, not rates, so they aren't scaled by the frame time. This keeps the old look speed at 60 frames per second
+	const float LookSensitivityScale = 1.0f / 60.0f;
+}
+
+AFPCharacter::AFPCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UFirstPersonCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	PrimaryActorTick.bCanEverTick = true;
 
+	// The camera sits at eye height, also where AI sight sees from
+	BaseEyeHeight = 70.0f;
+
+	// Server-only builds never look through the camera, so they don't even create it
+#if FIRSTPERSONCHARACTER_WITH_COSMETICS
 	SpringArmComponent = CreateDefaultSubobject<USpringArmComponent>(FName("SpringArmComponent"));
 	SpringArmComponent->TargetArmLength = 0.0f;
 	SpringArmComponent->SetupAttachment(GetCapsuleComponent());
 	
 	CameraComponent = CreateDefaultSubobject<UCameraComponent>(FName("CameraComponent"));
-	CameraComponent->SetRelativeLocation(FVector(0.0f, 0.0f, 70.0f));
+	CameraComponent->SetRelativeLocation(FVector(0.0f, 0.0f, BaseEyeHeight));
 	CameraComponent->bUsePawnControlRotation = true;
 	CameraComponent->SetupAttachment(SpringArmComponent);
 
+	CameraShakeComponent = CreateDefaultSubobject<UFirstPersonCameraShakeComponent>(FName("CameraShakeComponent"));
+#endif
+
 	// Other settings
 	GetCharacterMovement()->MaxWalkSpeed = 300.0f;
 	GetCharacterMovement()->JumpZVelocity = 300.0f;
@@ -48,48 +94,151 @@ void AFPCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Get access to the input settings
-	Input = const_cast<UInputSettings*>(GetDefault<UInputSettings>());
-
 	// Movement setup
 	CurrentWalkSpeed = Movement.WalkSpeed;
 	GetCharacterMovement()->MaxWalkSpeed = CurrentWalkSpeed;
 	GetCharacterMovement()->JumpZVelocity = Movement.JumpVelocity;
 	
+	// Bots mustn't change the view limits of the player
 	APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0);
-	if (CameraManager)
+	if (CameraManager && (AutoPossessPlayer != EAutoReceiveInput::Disabled || IsPlayerControlled()))
 	{
 		CameraManager->ViewPitchMin = Camera.MinPitch;
 		CameraManager->ViewPitchMax = Camera.MaxPitch;
 	}
 
+	// Nobody looks through the camera of a dedicated server. Builds with cosmetics create the components anyway, so
+	// that saved characters and their blueprints load the same way whatever the net mode
+	if (!HasCosmetics())
+	{
+		if (SpringArmComponent)
+			SpringArmComponent->DestroyComponent();
+		if (CameraComponent)
+			CameraComponent->DestroyComponent();
+		if (CameraShakeComponent)
+			CameraShakeComponent->DestroyComponent();
+
+		SpringArmComponent = nullptr;
+		CameraComponent = nullptr;
+		CameraShakeComponent = nullptr;
+	}
+
+	// The spring arm has no length, the camera stays where it is without it
+	if (!Camera.bUseSpringArm && SpringArmComponent && CameraComponent)
+	{
+		CameraComponent->AttachToComponent(GetCapsuleComponent(), FAttachmentTransformRules::KeepRelativeTransform);
+		SpringArmComponent->DestroyComponent();
+		SpringArmComponent = nullptr;
+	}
+
 	// Initialization
-	OriginalCameraLocation = CameraComponent->GetRelativeLocation();
+	OriginalCameraLocation = CameraComponent ? CameraComponent->GetRelativeLocation() : FVector(0.0f, 0.0f, BaseEyeHeight);
+	CameraBaseLocation = OriginalCameraLocation;
+	HeadBobOffset = FVector::ZeroVector;
 	OriginalCapsuleHalfHeight = GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	CrouchHalfHeight = OriginalCapsuleHalfHeight;
 
 	// Footstep setup
-	LastLocation = GetActorLocation();
 	LastFootstepLocation = GetActorLocation();
 	TravelDistance = 0;
+	OnCharacterMovementUpdated.AddDynamic(this, &AFPCharacter::OnMovementUpdated);
+	if (FootstepSettings.bEnableFootsteps && HasCosmetics())
+	{
+		if (FootstepSettings.Bank)
+			FootstepTable.Build(*FootstepSettings.Bank);
+		else
+			FootstepTable.Build(FootstepSettings.Mappings);
+	}
+	FootstepRandom.GenerateNewSeed();
 
-	// Input setup
-	SetupInputBindings();
+	// Load the sounds of the surfaces we know we'll walk on, and keep up with streaming levels
+	if (ShouldPlayFootsteps())
+	{
+		if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+			SurfaceMapsChangedHandle = CharacterSubsystem->OnSurfaceMapsChanged.AddUObject(this, &AFPCharacter::LoadLevelFootstepSounds);
+
+		LoadLevelFootstepSounds();
+	}
+
+	// Let the character subsystem update us together with everyone else
+	if (bUseBatchedUpdate && Movement.bPredictLocomotion)
+	{
+		UE_LOG(LogFirstPersonCharacter, Warning, TEXT("%s: the batched update is ignored while locomotion is predicted"), *GetName())
+	}
+	else if (bUseBatchedUpdate)
+	{
+		if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+		{
+			BatchedUpdateHandle = CharacterSubsystem->RegisterBatchedUpdate(this);
+			SetActorTickEnabled(false);
+		}
+	}
+
+	// Head bob setup
+	UpdateHeadBobRegistration();
+
+	// Significance setup
+	if (Significance.bEnableSignificance)
+	{
+		if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+			CharacterSubsystem->RegisterSignificance(this);
+	}
+
+	if (!InputRecorder)
+		InputRecorder = FindComponentByClass<UFirstPersonInputRecorderComponent>();
+
+	// Stop ticking while idle, unless a Blueprint relies on the Tick event
+	bCanRest = !GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(AFPCharacter, ReceiveTick));
+	WakeLocomotion();
+}
+
+void AFPCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFirstPersonClearanceSubsystem* ClearanceSubsystem = GetWorld()->GetSubsystem<UFirstPersonClearanceSubsystem>())
+		ClearanceSubsystem->Forget(this);
+
+	if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+	{
+		if (HeadBobHandle != INDEX_NONE)
+			CharacterSubsystem->UnregisterHeadBob(HeadBobHandle);
+
+		if (BatchedUpdateHandle != INDEX_NONE)
+			CharacterSubsystem->UnregisterBatchedUpdate(BatchedUpdateHandle);
+
+		CharacterSubsystem->UnregisterSignificance(this);
+		CharacterSubsystem->OnSurfaceMapsChanged.Remove(SurfaceMapsChangedHandle);
+	}
+
+	HeadBobHandle = INDEX_NONE;
+	BatchedUpdateHandle = INDEX_NONE;
+
+	GetWorldTimerManager().ClearTimer(ShakeRestartTimerHandle);
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AFPCharacter::Tick(const float DeltaTime)
 {
+	SCOPE_CYCLE_COUNTER(STAT_FirstPersonCharacterTick);
+	CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, Tick);
+
 	Super::Tick(DeltaTime);
 
 	UpdateCameraShake();
 
-	UpdateCrouch(DeltaTime);
-	UpdateWalkingSpeed();
+	if (!IsLocomotionPredicted())
+		UpdateLocomotion(DeltaTime);
+
+	TryRestLocomotion();
 }
 
 void AFPCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 {
 	Super::SetupPlayerInputComponent(PlayerInputComponent);
 
+	// Key bindings of the player that controls us
+	SetupInputBindings();
+
 	// Axis bindings
 	PlayerInputComponent->BindAxis(FName("MoveForward"), this, &AFPCharacter::MoveForward);
 	PlayerInputComponent->BindAxis(FName("MoveRight"), this, &AFPCharacter::MoveRight);
@@ -109,15 +258,35 @@ void AFPCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCompone
 
 void AFPCharacter::Jump()
 {
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::JumpPressed);
+
 	if (CrouchPhase == ECrouchPhase::Standing)
 	{
 		Super::Jump();
 
 		// Play jump camera shake
-		PlayerController->ClientStartCameraShake(CameraShakes.JumpShake);
+		if (CameraShakeComponent)
+			CameraShakeComponent->PlayOneShot(CameraShakes.JumpShake);
 	}
 }
 
+void AFPCharacter::StopJumping()
+{
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::JumpReleased);
+
+	Super::StopJumping();
+}
+
+void AFPCharacter::SetJumpIntent(const bool bJump)
+{
+	if (bJump)
+		Jump();
+	else
+		StopJumping();
+}
+
 void AFPCharacter::Landed(const FHitResult& Hit)
 {
 	if (CrouchPhase == ECrouchPhase::Standing)
@@ -125,10 +294,12 @@ void AFPCharacter::Landed(const FHitResult& Hit)
 		Super::Landed(Hit);
 
 		// Play jump camera shake
-		PlayerController->ClientStartCameraShake(CameraShakes.JumpShake, 3.0f);
+		if (CameraShakeComponent)
+			CameraShakeComponent->PlayOneShot(CameraShakes.JumpShake, 3.0f);
 
-		if (FootstepSettings.bEnableFootsteps)
-			PlayFootstepSound();
+		// The landing hit is our floor, the movement component hasn't found it yet
+		if (ShouldPlayFootsteps())
+			PlayFootstepSound(&Hit);
 	}
 }
 
@@ -137,47 +308,89 @@ void AFPCharacter::PossessedBy(AController* NewController)
 	Super::PossessedBy(NewController);
 
 	PlayerController = Cast<APlayerController>(NewController);
+
+	// Command line recordings and replays are of the first local player
+	if (UFirstPersonInputRecorderComponent::IsRequestedOnCommandLine() && !InputRecorder && PlayerController && PlayerController->IsLocalController() && PlayerController == UGameplayStatics::GetPlayerController(this, 0))
+	{
+		InputRecorder = NewObject<UFirstPersonInputRecorderComponent>(this, FName("InputRecorder"));
+		InputRecorder->RegisterComponent();
+		InputRecorder->StartFromCommandLine();
+	}
+
+	// Camera shakes depend on who controls us
+	WakeLocomotion();
+}
+
+void AFPCharacter::NotifyControllerChanged()
+{
+	Super::NotifyControllerChanged();
+
+	// Runs on possession changes on the server and when the controller replicates to clients
+	if (HasActorBegunPlay())
+		UpdateHeadBobRegistration();
+}
+
+void AFPCharacter::OnMovementModeChanged(const EMovementMode PrevMovementMode, const uint8 PreviousCustomMode)
+{
+	Super::OnMovementModeChanged(PrevMovementMode, PreviousCustomMode);
+
+	// Jumping, falling and landing change the camera shakes
+	WakeLocomotion();
+
+	// Simulated proxies don't process landings, but the replicated movement mode tells us when they touch down
+	if (GetLocalRole() == ROLE_SimulatedProxy && PrevMovementMode == MOVE_Falling && GetCharacterMovement()->IsMovingOnGround()
+		&& CrouchPhase == ECrouchPhase::Standing && ShouldPlayFootsteps())
+	{
+		PlayFootstepSound();
+	}
 }
 
 void AFPCharacter::StartCrouch()
 {
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::CrouchPressed);
+
 	switch (Movement.CrouchActionType)
 	{
 		case EPlayerActionType::Hold:
-		{
-			bWantsToCrouch = true;
-			CrouchPhase = ECrouchPhase::InTransition;
+			SetCrouchIntent(true);
 			break;
-		}
 		
 		case EPlayerActionType::Toggle:
-		{
-			if (bWantsToCrouch && !IsBlockedInCrouchStance())
-			{
-				bWantsToCrouch = false;
-				CrouchPhase = ECrouchPhase::InTransition;
-			}
-			else if(!bWantsToCrouch)
-			{
-				bWantsToCrouch = true;
-				CrouchPhase = ECrouchPhase::InTransition;
-			}
+			SetCrouchIntent(!bWantsToCrouch);
 			break;
-		}
 	}
 }
 
 void AFPCharacter::StopCrouching()
 {
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::CrouchReleased);
+
 	if (Movement.CrouchActionType == EPlayerActionType::Hold)
-	{
-		bWantsToCrouch = false;
-		CrouchPhase = ECrouchPhase::InTransition;
-	}
+		SetCrouchIntent(false);
+}
+
+bool AFPCharacter::SetCrouchIntent(const bool bCrouch)
+{
+	if (bCrouch == bWantsToCrouch)
+		return true;
+
+	// Held crouches wait for room to stand up in the locomotion update, toggled ones don't stand up at all
+	if (!bCrouch && Movement.CrouchActionType == EPlayerActionType::Toggle && IsBlockedInCrouchStance())
+		return false;
+
+	bWantsToCrouch = bCrouch;
+	CrouchPhase = ECrouchPhase::InTransition;
+	WakeLocomotion();
+	return true;
 }
 
 void AFPCharacter::MoveForward(const float AxisValue)
 {
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::MoveForward, AxisValue);
+
 	if (Controller)
 	{
 		FRotator ForwardRotation = Controller->GetControlRotation();
@@ -191,34 +404,134 @@ void AFPCharacter::MoveForward(const float AxisValue)
 
 		// Apply movement in the calculated direction
 		AddMovementInput(Direction, AxisValue);
+	}
+}
 
-		if (FootstepSettings.bEnableFootsteps)
-		{
-			// Continously add to Travel Distance when moving
-			if (GetCharacterMovement()->Velocity.Size() > 0.0f && GetCharacterMovement()->IsMovingOnGround())
-			{
-				TravelDistance += (GetActorLocation() - LastLocation).Size();
-				LastLocation = GetActorLocation();
-			}
-			// Reset when not moving AND if we are falling
-			else if (GetCharacterMovement()->IsFalling())
-			{
-				LastLocation = GetActorLocation();
-				TravelDistance = 0.0f;
-			}
+void AFPCharacter::AddMoveIntent(const FVector2D Move)
+{
+	MoveForward(Move.X);
+	MoveRight(Move.Y);
+}
 
-			// Is it time to play a footstep sound?
-			if (GetCharacterMovement()->IsMovingOnGround() && TravelDistance > FootstepSettings.CurrentStride)
-			{
-				PlayFootstepSound();
-				TravelDistance = 0;
-			}
+void AFPCharacter::AddLookIntent(const FVector2D LookDelta)
+{
+	if (!Controller || LookDelta.IsZero())
+		return;
+
+	// Players rotate with the rest of their input, within the limits of their camera manager
+	APlayerController* LocalPlayerController = Cast<APlayerController>(Controller);
+	if (LocalPlayerController && LocalPlayerController->IsLocalController())
+	{
+		if (!LocalPlayerController->IsLookInputIgnored())
+		{
+			LocalPlayerController->RotationInput.Yaw += LookDelta.X;
+			LocalPlayerController->RotationInput.Pitch += LookDelta.Y;
 		}
+		return;
 	}
+
+	FRotator ControlRotation = Controller->GetControlRotation();
+	ControlRotation.Yaw = FRotator::NormalizeAxis(ControlRotation.Yaw + LookDelta.X);
+	ControlRotation.Pitch = FMath::Clamp(FRotator::NormalizeAxis(ControlRotation.Pitch + LookDelta.Y), Camera.MinPitch, Camera.MaxPitch);
+	Controller->SetControlRotation(ControlRotation);
+}
+
+void AFPCharacter::OnMovementUpdated(const float DeltaSeconds, const FVector OldLocation, const FVector OldVelocity)
+{
+	// Starting or stopping to move changes the camera shakes, whether it came from input or from being pushed
+	if (!bLocomotionAwake && UsesLocomotionShakes() && GetLocomotionState() != CameraShakeComponent->GetLocomotionState())
+	{
+		WakeLocomotion();
+	}
+
+	// Moves replayed after a correction already played their footsteps the first time
+	if (GetCharacterMovement()->bClientUpdating)
+		return;
+
+	// Simulated proxies get here too, so other players' footsteps come from their replicated movement
+	if (ShouldPlayFootsteps())
+		UpdateFootstepStride(DeltaSeconds, OldLocation);
+}
+
+bool AFPCharacter::HasCosmetics() const
+{
+#if FIRSTPERSONCHARACTER_WITH_COSMETICS
+	return GetNetMode() != NM_DedicatedServer;
+#else
+	return false;
+#endif
+}
+
+bool AFPCharacter::ShouldPlayFootsteps() const
+{
+	return FootstepSettings.bEnableFootsteps && HasCosmetics() && CurrentSignificance != EFirstPersonSignificance::Low;
+}
+
+bool AFPCharacter::IsRunning() const
+{
+	// Simulated proxies don't know the run intent, but their replicated velocity tells the same story
+	if (GetLocalRole() == ROLE_SimulatedProxy)
+		return GetVelocity().SizeSquared2D() > FMath::Square((Movement.WalkSpeed + Movement.RunSpeed) * 0.5f);
+
+	return bWantsToRun;
+}
+
+void AFPCharacter::OnRep_WantsToCrouch()
+{
+	// The tick steps the proxy's capsule and camera towards the new stance
+	WakeLocomotion();
+}
+
+void AFPCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// Only sent when the stance changes. The owner predicts it, and the server gets it with each move
+	DOREPLIFETIME_CONDITION(AFPCharacter, bWantsToCrouch, COND_SimulatedOnly);
+}
+
+void AFPCharacter::UpdateFootstepStride(const float DeltaSeconds, const FVector& OldLocation)
+{
+	const UCharacterMovementComponent* CharacterMovement = GetCharacterMovement();
+
+	// Reset while falling, landing plays its own footstep
+	if (!CharacterMovement->IsMovingOnGround())
+	{
+		TravelDistance = 0.0f;
+		return;
+	}
+
+	// This is the whole path of the movement update, whatever input caused it
+	const float Distance = CharacterMovement->bJustTeleported ? 0.0f : (GetActorLocation() - OldLocation).Size();
+	if (Distance <= 0.0f || DeltaSeconds <= 0.0f)
+		return;
+
+	// Play a footstep for every stride boundary crossed during this update. The sounds start at the end of the frame, so at low frame rates
+	// a footstep can be up to a frame late, but the leftover distance carries over and the strides themselves stay exact
+	const int32 MaxFootstepsPerUpdate = 4;
+	float DistanceToStep = FMath::Max(FMath::Max(FootstepSettings.CurrentStride, 1.0f) - TravelDistance, 0.0f);
+	float TravelledThisUpdate = 0.0f;
+	for (int32 i = 0; i < MaxFootstepsPerUpdate && TravelledThisUpdate + DistanceToStep <= Distance; i++)
+	{
+		TravelledThisUpdate += DistanceToStep;
+		TravelDistance = 0.0f;
+
+		// Traced with how long ago the boundary was crossed, which is how late its footstep is
+		TRACE_FIRSTPERSON_STRIDE(this, FootstepSettings.CurrentStride, (1.0f - TravelledThisUpdate / Distance) * DeltaSeconds);
+		PlayFootstepSound();
+
+		// The footstep picks the stride of the surface we're on
+		DistanceToStep = FMath::Max(FootstepSettings.CurrentStride, 1.0f);
+	}
+
+	TravelDistance = FMath::Min(TravelDistance + Distance - TravelledThisUpdate, FootstepSettings.CurrentStride);
 }
 
 void AFPCharacter::MoveRight(const float AxisValue)
 {
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::MoveRight, AxisValue);
+
 	if (Controller)
 	{
 		// Find out which way is right
@@ -232,78 +545,261 @@ void AFPCharacter::MoveRight(const float AxisValue)
 
 void AFPCharacter::Run()
 {
-	bWantsToRun = true;
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::RunPressed);
+
+	SetRunIntent(true);
 }
 
 void AFPCharacter::StopRunning()
 {
-	bWantsToRun = false;
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::RunReleased);
+
+	SetRunIntent(false);
 }
 
-void AFPCharacter::UpdateWalkingSpeed()
+void AFPCharacter::SetRunIntent(const bool bRun)
 {
-	if (CrouchPhase == ECrouchPhase::Standing)
-	{
-		CurrentWalkSpeed = bWantsToRun ? Movement.RunSpeed : Movement.WalkSpeed;
-		GetCharacterMovement()->MaxWalkSpeed = CurrentWalkSpeed;
-	}
+	bWantsToRun = bRun;
+	WakeLocomotion();
 }
 
-void AFPCharacter::UpdateCrouch(const float DeltaTime)
+void AFPCharacter::UpdateLocomotion(const float DeltaTime)
 {
-	if (CrouchPhase == ECrouchPhase::InTransition)
+	SCOPE_CYCLE_COUNTER(STAT_FirstPersonUpdateLocomotion);
+	CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, UpdateLocomotion);
+
+	FFirstPersonLocomotionState State = CaptureLocomotion();
+	StepLocomotion(State, bWantsToCrouch, bWantsToRun, IsStandUpBlocked(), GetLocomotionParams(), DeltaTime);
+	ApplyLocomotion(State);
+}
+
+void AFPCharacter::StepLocomotion(FFirstPersonLocomotionState& State, const bool bCrouchIntent, const bool bRunIntent, const bool bStandUpBlocked, const FFirstPersonLocomotionParams& Params, const float DeltaTime)
+{
+	// The intent can change without an input event, e.g. on the server when it arrives with a move
+	if ((State.CrouchPhase == ECrouchPhase::Standing && bCrouchIntent) || (State.CrouchPhase == ECrouchPhase::Crouching && !bCrouchIntent))
+		State.CrouchPhase = ECrouchPhase::InTransition;
+
+	if (State.CrouchPhase == ECrouchPhase::InTransition)
 	{
 		const float ErrorMargin = 2.0f;
-		if (bWantsToCrouch)
+		// Frame rate independent, so the transition looks the same at any tick interval and never overshoots
+		const float Alpha = 1.0f - FMath::Exp(-Params.TransitionSpeed * DeltaTime);
+		const float CrouchingHalfHeight = Params.StandingHalfHeight / 2.0f;
+		const FVector CrouchingCameraLocation(0.0f, 0.0f, 30.0f);
+
+		if (bCrouchIntent)
 		{
 			// Smoothly move camera to target location and smoothly decrease the capsule height to fit through small openings
-			const FVector NewLocation = FMath::Lerp(CameraComponent->GetRelativeLocation(), FVector(0.0f, 0.0f, 30.0f), Movement.StandToCrouchTransitionSpeed * DeltaTime);
-			const float NewHalfHeight = FMath::Lerp(GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight(), OriginalCapsuleHalfHeight/2.0f, Movement.StandToCrouchTransitionSpeed * DeltaTime);
-			const float NewWalkSpeed = FMath::Lerp(GetCharacterMovement()->MaxWalkSpeed, Movement.CrouchSpeed, Movement.StandToCrouchTransitionSpeed * DeltaTime);
-			
+			const FVector NewLocation = FMath::Lerp(State.CameraLocation, CrouchingCameraLocation, Alpha);
+			const float NewHalfHeight = FMath::Lerp(State.CrouchHalfHeight, CrouchingHalfHeight, Alpha);
+			const float NewWalkSpeed = FMath::Lerp(State.MaxWalkSpeed, Params.CrouchSpeed, Alpha);
 
 			// Change CrouchPhase when we reach the target
-			if (FMath::IsNearlyEqual(NewHalfHeight, OriginalCapsuleHalfHeight / 2.0f, ErrorMargin))
+			if (FMath::IsNearlyEqual(NewHalfHeight, CrouchingHalfHeight, ErrorMargin))
 			{
-				CameraComponent->SetRelativeLocation(FVector(0.0f, 0.0f, 30.0f));
-				GetCapsuleComponent()->SetCapsuleHalfHeight(OriginalCapsuleHalfHeight / 2.0f);
-				GetCharacterMovement()->MaxWalkSpeed = Movement.CrouchSpeed;
-				CrouchPhase = ECrouchPhase::Crouching;
+				State.CameraLocation = CrouchingCameraLocation;
+				State.CrouchHalfHeight = CrouchingHalfHeight;
+				State.MaxWalkSpeed = Params.CrouchSpeed;
+				State.CrouchPhase = ECrouchPhase::Crouching;
 			}
 			else
 			{
-				CameraComponent->SetRelativeLocation(NewLocation);
-				GetCapsuleComponent()->SetCapsuleHalfHeight(NewHalfHeight);
-				GetCharacterMovement()->MaxWalkSpeed = NewWalkSpeed;
+				State.CameraLocation = NewLocation;
+				State.CrouchHalfHeight = NewHalfHeight;
+				State.MaxWalkSpeed = NewWalkSpeed;
 			}
 		}
-		else if (!((Movement.CrouchActionType == EPlayerActionType::Hold) && IsBlockedInCrouchStance()))
+		else if (!bStandUpBlocked)
 		{
 			// Smoothly move camera back to original location and smoothly increase the capsule height to the original height
-			const FVector NewLocation = FMath::Lerp(CameraComponent->GetRelativeLocation(), OriginalCameraLocation, Movement.StandToCrouchTransitionSpeed * DeltaTime);
-			const float NewHalfHeight = FMath::Lerp(GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight(), OriginalCapsuleHalfHeight, Movement.StandToCrouchTransitionSpeed * DeltaTime);
-			const float NewWalkSpeed = FMath::Lerp(GetCharacterMovement()->MaxWalkSpeed, CurrentWalkSpeed, Movement.StandToCrouchTransitionSpeed * DeltaTime);
+			const FVector NewLocation = FMath::Lerp(State.CameraLocation, Params.StandingCameraLocation, Alpha);
+			const float NewHalfHeight = FMath::Lerp(State.CrouchHalfHeight, Params.StandingHalfHeight, Alpha);
+			const float NewWalkSpeed = FMath::Lerp(State.MaxWalkSpeed, State.CurrentWalkSpeed, Alpha);
 
 			// Change CrouchPhase when we reach the target
-			if (FMath::IsNearlyEqual(NewHalfHeight, OriginalCapsuleHalfHeight, ErrorMargin))
+			if (FMath::IsNearlyEqual(NewHalfHeight, Params.StandingHalfHeight, ErrorMargin))
 			{
-				CameraComponent->SetRelativeLocation(OriginalCameraLocation);
-				GetCapsuleComponent()->SetCapsuleHalfHeight(OriginalCapsuleHalfHeight);
-				CrouchPhase = ECrouchPhase::Standing;
-				GetCharacterMovement()->MaxWalkSpeed = CurrentWalkSpeed;
+				State.CameraLocation = Params.StandingCameraLocation;
+				State.CrouchHalfHeight = Params.StandingHalfHeight;
+				State.MaxWalkSpeed = State.CurrentWalkSpeed;
+				State.CrouchPhase = ECrouchPhase::Standing;
 			}
 			else
 			{
-				CameraComponent->SetRelativeLocation(NewLocation);
-				GetCapsuleComponent()->SetCapsuleHalfHeight(NewHalfHeight);
-				GetCharacterMovement()->MaxWalkSpeed = NewWalkSpeed;
+				State.CameraLocation = NewLocation;
+				State.CrouchHalfHeight = NewHalfHeight;
+				State.MaxWalkSpeed = NewWalkSpeed;
 			}
 		}
 	}
+
+	// Walking/Sprinting
+	if (State.CrouchPhase == ECrouchPhase::Standing)
+	{
+		State.CurrentWalkSpeed = bRunIntent ? Params.RunSpeed : Params.WalkSpeed;
+		State.MaxWalkSpeed = State.CurrentWalkSpeed;
+	}
+}
+
+FFirstPersonLocomotionState AFPCharacter::CaptureLocomotion() const
+{
+	// Batched characters only get a copy of their state when it changes, the subsystem has the latest
+	if (BatchedUpdateHandle != INDEX_NONE)
+	{
+		if (const UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+			return CharacterSubsystem->GetBatchedLocomotion(BatchedUpdateHandle);
+	}
+
+	FFirstPersonLocomotionState State;
+	State.CrouchPhase = CrouchPhase;
+	State.CurrentWalkSpeed = CurrentWalkSpeed;
+	State.MaxWalkSpeed = GetCharacterMovement()->MaxWalkSpeed;
+	State.CrouchHalfHeight = CrouchHalfHeight;
+	State.CameraLocation = CameraBaseLocation;
+	return State;
+}
+
+FFirstPersonLocomotionParams AFPCharacter::GetLocomotionParams() const
+{
+	FFirstPersonLocomotionParams Params;
+	Params.WalkSpeed = Movement.WalkSpeed;
+	Params.RunSpeed = Movement.RunSpeed;
+	Params.CrouchSpeed = Movement.CrouchSpeed;
+	Params.TransitionSpeed = Movement.StandToCrouchTransitionSpeed;
+	Params.StandingHalfHeight = OriginalCapsuleHalfHeight;
+	Params.StandingCameraLocation = OriginalCameraLocation;
+	return Params;
+}
+
+bool AFPCharacter::IsStandUpBlocked(const bool bAllowCachedResult)
+{
+	// Simulated proxies just follow the replicated intent. The server moves them, so standing up under something is only cosmetic
+	if (GetLocalRole() == ROLE_SimulatedProxy)
+		return false;
+
+	// Toggle mode checks for room when the key is pressed, hold mode keeps checking while standing up
+	return CrouchPhase != ECrouchPhase::Standing && !bWantsToCrouch
+		&& Movement.CrouchActionType == EPlayerActionType::Hold && IsBlockedInCrouchStance(bAllowCachedResult);
+}
+
+bool AFPCharacter::IsLocomotionPredicted() const
+{
+	// Simulated proxies don't run moves, they're updated by the tick
+	return Movement.bPredictLocomotion && GetLocalRole() != ROLE_SimulatedProxy
+		&& GetCharacterMovement()->IsA<UFirstPersonCharacterMovementComponent>();
+}
+
+void AFPCharacter::UpdatePredictedLocomotion(const float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FirstPersonUpdateLocomotion);
+	CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, UpdateLocomotion);
+
+	// Both sides have to come to the same answer, so the first simulation of a move can't use last frame's async sweep.
+	// IsStandUpBlocked only sweeps while a held crouch is being released. Replays of a correction reuse the cheap async answer instead
+	const bool bStandUpBlocked = IsStandUpBlocked(GetCharacterMovement()->bClientUpdating);
+
+	FFirstPersonLocomotionState State = CaptureLocomotion();
+	StepLocomotion(State, bWantsToCrouch, bWantsToRun, bStandUpBlocked, GetLocomotionParams(), DeltaSeconds);
+	ApplyLocomotion(State);
+}
+
+void AFPCharacter::ApplyLocomotion(const FFirstPersonLocomotionState& State, const bool bForce)
+{
+	const bool bWasInTransition = CrouchPhase == ECrouchPhase::InTransition;
+
+#if FIRSTPERSONCHARACTER_TRACE_ENABLED
+	if (CrouchPhase != State.CrouchPhase)
+		TRACE_FIRSTPERSON_CROUCH_PHASE(this, State.CrouchPhase);
+
+	if (GetCharacterMovement()->MaxWalkSpeed != State.MaxWalkSpeed)
+		TRACE_FIRSTPERSON_WALK_SPEED(this, State.MaxWalkSpeed);
+#endif
+
+	CrouchPhase = State.CrouchPhase;
+	CurrentWalkSpeed = State.CurrentWalkSpeed;
+	GetCharacterMovement()->MaxWalkSpeed = State.MaxWalkSpeed;
+
+	if (bWasInTransition || CrouchPhase == ECrouchPhase::InTransition || bForce)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_CrouchTransition);
+		CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, CrouchTransition);
+		INC_DWORD_STAT(STAT_ActiveCrouchTransitions);
+		CSV_CUSTOM_STAT(FirstPersonCharacter, ActiveCrouchTransitions, 1, ECsvCustomStatOp::Accumulate);
+
+		// Defer overlap updates and transform propagation of the capsule until we're done with it
+		FScopedMovementUpdate ScopedCapsuleUpdate(GetCapsuleComponent(), EScopedUpdate::DeferredUpdates);
+
+		SetCrouchHalfHeight(State.CrouchHalfHeight, CrouchPhase != ECrouchPhase::InTransition);
+
+		CameraBaseLocation = State.CameraLocation;
+		ApplyCameraLocation();
+	}
+}
+
+void AFPCharacter::WakeLocomotion()
+{
+	bLocomotionAwake = true;
+	GetWorldTimerManager().ClearTimer(ShakeRestartTimerHandle);
+
+	// Batched characters never tick, the subsystem skips them while they rest instead. Every wake up comes with new intents
+	if (BatchedUpdateHandle == INDEX_NONE)
+		SetActorTickEnabled(true);
+	else if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+		CharacterSubsystem->WakeBatchedUpdate(BatchedUpdateHandle, bWantsToCrouch, bWantsToRun);
+}
+
+bool AFPCharacter::TryRestLocomotion()
+{
+	if (!bCanRest || !IsLocomotionSettled())
+		return false;
+
+	bLocomotionAwake = false;
+	if (BatchedUpdateHandle == INDEX_NONE)
+		SetActorTickEnabled(false);
+
+	// Shake assets that don't loop need to be restarted when they run out
+	if (UsesLocomotionShakes())
+	{
+		const float ShakeTimeRemaining = CameraShakeComponent->GetLocomotionShakeTimeRemaining();
+		if (ShakeTimeRemaining < MAX_flt)
+			GetWorldTimerManager().SetTimer(ShakeRestartTimerHandle, this, &AFPCharacter::WakeLocomotion, FMath::Max(ShakeTimeRemaining, 0.05f));
+	}
+
+	return true;
+}
+
+bool AFPCharacter::IsLocomotionSettled() const
+{
+	// The walk speed reaches its target right away outside of crouch transitions, and predicted transitions don't need the tick
+	if (CrouchPhase == ECrouchPhase::InTransition && !IsLocomotionPredicted())
+		return false;
+
+	// Otherwise only the camera shakes can still change, and movement updates wake us when they do
+	return !UsesLocomotionShakes() || GetLocomotionState() == CameraShakeComponent->GetLocomotionState();
+}
+
+void AFPCharacter::SetCrouchHalfHeight(const float NewHalfHeight, const bool bExact)
+{
+	CrouchHalfHeight = NewHalfHeight;
+
+	// Resizing the capsule is expensive, so only do it in steps while the camera moves smoothly
+	const float Step = Movement.CrouchCapsuleHeightStep;
+	const float CapsuleHalfHeight = (bExact || Step <= 0.0f) ? NewHalfHeight : FMath::GridSnap(NewHalfHeight, Step);
+
+	if (!FMath::IsNearlyEqual(CapsuleHalfHeight, GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight()))
+	{
+		GetCapsuleComponent()->SetCapsuleHalfHeight(CapsuleHalfHeight);
+		INC_DWORD_STAT(STAT_CrouchCapsuleResizes);
+	}
 }
 
-bool AFPCharacter::IsBlockedInCrouchStance()
+bool AFPCharacter::IsBlockedInCrouchStance(const bool bAllowCachedResult)
 {
+	SCOPE_CYCLE_COUNTER(STAT_IsBlockedInCrouchStance);
+	CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, IsBlockedInCrouchStance);
+
 	// Cast a sphere abouve the character
 	const FVector StartLocation = GetActorLocation();
 	const float CurrentHalfHeight = GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight_WithoutHemisphere();
@@ -311,53 +807,115 @@ bool AFPCharacter::IsBlockedInCrouchStance()
 		? CurrentHalfHeight + Movement.BlockTestOffset
 		: OriginalCapsuleHalfHeight;
 	const FVector EndLocation = StartLocation + TraceDistance * GetActorUpVector();
-	const FCollisionShape CollisionSphere
-		= FCollisionShape::MakeSphere(GetCapsuleComponent()->GetUnscaledCapsuleRadius());
+	const float SphereRadius = GetCapsuleComponent()->GetUnscaledCapsuleRadius();
 	
-	FHitResult HitResult;
 	FCollisionQueryParams SphereParams(SCENE_QUERY_STAT(CrouchTrace), false, this);
 	FCollisionResponseParams ResponseParams;
 	GetCharacterMovement()->InitCollisionParams(SphereParams, ResponseParams);
 
-	bool bHasHit = GetWorld()->SweepSingleByChannel(
-		HitResult,
-		StartLocation,
-		EndLocation,
-		FQuat::Identity,
-		ECC_Visibility,
-		CollisionSphere,
-		SphereParams,
-		ResponseParams
-	);
-	
-	if (bHasHit)
+	UFirstPersonClearanceSubsystem* ClearanceSubsystem = GetWorld()->GetSubsystem<UFirstPersonClearanceSubsystem>();
+	if (!ClearanceSubsystem)
+		return false;
+
+	// Let the async sweeps of the clearance subsystem answer the per-frame checks
+	if (bAllowCachedResult)
+		return ClearanceSubsystem->IsBlocked(this, StartLocation, EndLocation, SphereRadius, ECC_Visibility, SphereParams, ResponseParams);
+
+	return ClearanceSubsystem->IsBlockedNow(this, StartLocation, EndLocation, SphereRadius, ECC_Visibility, SphereParams, ResponseParams);
+}
+
+void AFPCharacter::UpdateCameraShake()
+{
+#if FIRSTPERSONCHARACTER_WITH_COSMETICS
+	SCOPE_CYCLE_COUNTER(STAT_FirstPersonUpdateCameraShake);
+
+	// Shakes are purely cosmetic, only the owning client plays them
+	if (!CameraShakeComponent || !IsLocallyControlled() || !IsPlayerControlled())
+		return;
+
+	// The procedural head bob replaces the locomotion shakes
+	if (HeadBob.Mode == EHeadBobMode::Procedural)
+		CameraShakeComponent->StopLocomotionShakes(false);
+	else
+		CameraShakeComponent->UpdateLocomotionState(GetLocomotionState(), CameraShakes);
+#endif
+}
+
+void AFPCharacter::UpdateHeadBobRegistration()
+{
+	UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>();
+	if (!CharacterSubsystem)
+		return;
+
+	// Like the locomotion shakes, only the camera of the local player bobs
+	const bool bWantsHeadBob = HeadBob.Mode == EHeadBobMode::Procedural && CameraComponent && HasCosmetics() && IsLocallyControlled() && IsPlayerControlled();
+	if (bWantsHeadBob && HeadBobHandle == INDEX_NONE)
 	{
-		// Return true only if the hit actor doesn't simulate physics
-		USceneComponent* HitComponent = HitResult.GetComponent();
-		bool bOtherSimulatesPhysics = HitComponent->IsSimulatingPhysics();
-		return !bOtherSimulatesPhysics;
+		HeadBobHandle = CharacterSubsystem->RegisterHeadBob(this);
 	}
-	else
+	else if (!bWantsHeadBob && HeadBobHandle != INDEX_NONE)
 	{
-		return false;
+		CharacterSubsystem->UnregisterHeadBob(HeadBobHandle);
+		HeadBobHandle = INDEX_NONE;
+
+		HeadBobOffset = FVector::ZeroVector;
+		ApplyCameraLocation();
 	}
 }
 
-void AFPCharacter::UpdateCameraShake()
-{	
-	if (PlayerController)
+bool AFPCharacter::UsesLocomotionShakes() const
+{
+	// Only a local player has a camera manager to play them on
+	return CameraShakeComponent && HeadBob.Mode == EHeadBobMode::CameraShake && IsLocallyControlled() && IsPlayerControlled();
+}
+
+void AFPCharacter::SetSignificance(const EFirstPersonSignificance NewSignificance)
+{
+	if (NewSignificance == CurrentSignificance)
+		return;
+
+	CurrentSignificance = NewSignificance;
+
+	switch (NewSignificance)
 	{
-		// Shake camera (Walking shake)
-		if (GetVelocity().Size() > 0 && CanJump())
-			PlayerController->ClientStartCameraShake(CameraShakes.WalkShake, 2.0f);
-		// Shake camera (breathing shake)
-		else
-			PlayerController->ClientStartCameraShake(CameraShakes.IdleShake, 1.0f);
-		
-		// Shake camera (Run shake)
-		if (GetVelocity().Size() > 0 && GetCharacterMovement()->MaxWalkSpeed >= Movement.RunSpeed && CanJump())
-			PlayerController->ClientStartCameraShake(CameraShakes.RunShake, 1.0f);
+		case EFirstPersonSignificance::High:
+			SignificanceTickInterval = 0.0f;
+			break;
+
+		case EFirstPersonSignificance::Medium:
+			SignificanceTickInterval = Significance.MediumTickInterval;
+			break;
+
+		case EFirstPersonSignificance::Low:
+			SignificanceTickInterval = Significance.LowTickInterval;
+			break;
 	}
+
+	// Tick receives the time since it last ran, and the locomotion update copes with any delta time
+	SetActorTickInterval(SignificanceTickInterval);
+
+	if (BatchedUpdateHandle != INDEX_NONE)
+	{
+		if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+			CharacterSubsystem->SetBatchedTickInterval(BatchedUpdateHandle, SignificanceTickInterval);
+	}
+}
+
+void AFPCharacter::ApplyCameraLocation()
+{
+	if (CameraComponent)
+		CameraComponent->SetRelativeLocation(CameraBaseLocation + HeadBobOffset);
+}
+
+ELocomotionState AFPCharacter::GetLocomotionState() const
+{
+	if (GetCharacterMovement()->IsFalling())
+		return ELocomotionState::Airborne;
+
+	if (GetVelocity().SizeSquared() <= 0.0f)
+		return ELocomotionState::Idle;
+
+	return GetCharacterMovement()->MaxWalkSpeed >= Movement.RunSpeed ? ELocomotionState::Running : ELocomotionState::Walking;
 }
 
 void AFPCharacter::Quit()
@@ -367,150 +925,213 @@ void AFPCharacter::Quit()
 
 void AFPCharacter::Interact()
 {
-	UE_LOG(LogTemp, Warning, TEXT("No functionality, derive from this character and implement this event"))
+	UE_LOG(LogFirstPersonCharacter, Warning, TEXT("No functionality, derive from this character and implement this event"))
 }
 
-void AFPCharacter::PlayFootstepSound()
+void AFPCharacter::PlayFootstepSound(const FHitResult* FloorHit)
 {
-	GetCharacterMovement()->FindFloor(GetCapsuleComponent()->GetComponentLocation(), FloorResult, false);
+#if FIRSTPERSONCHARACTER_WITH_COSMETICS
+	SCOPE_CYCLE_COUNTER(STAT_PlayFootstepSound);
+	CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, PlayFootstepSound);
 
-	if (FloorResult.bBlockingHit)
+	NumFootstepsRequested++;
+
+	FVector FootstepLocation;
+	const UPhysicalMaterial* Surface = nullptr;
+	bool bBakedSurface = true;
+
+	// Static floors can be looked up in the level's baked surface map, moving ones need the floor hit
+	if (FloorHit || !FindBakedFootstepSurface(FootstepLocation, Surface))
 	{
-		if (IsValid(GetFootstepSound(&FloorResult.HitResult.PhysMaterial)))
-		{
-			if (CrouchPhase != ECrouchPhase::Standing)
-				UGameplayStatics::PlaySoundAtLocation(this, GetFootstepSound(&FloorResult.HitResult.PhysMaterial), FloorResult.HitResult.Location, 0.35f);
-			else
-				UGameplayStatics::PlaySoundAtLocation(this, GetFootstepSound(&FloorResult.HitResult.PhysMaterial), FloorResult.HitResult.Location);
-		}
-		else
-		{
-			AActor* FloorActor = FloorResult.HitResult.GetActor();
-			if (FloorActor)
-				UE_LOG(LogTemp, Warning, TEXT("No physical material found for %s"), *FloorActor->GetName())
-		}
+		// Prefer a floor we already know about over a new sweep
+		if (!FloorHit)
+			FloorHit = FindFootstepFloor();
+
+		if (!FloorHit)
+			return;
+
+		FootstepLocation = FloorHit->Location;
+		Surface = GetFloorSurface(*FloorHit);
+		bBakedSurface = false;
 	}
 
-	LastFootstepLocation = FloorResult.HitResult.Location;
-}
+	USoundBase* FootstepSound = GetFootstepSound(Surface);
+	TRACE_FIRSTPERSON_FOOTSTEP(this, Surface, FootstepSound, bBakedSurface);
 
-USoundBase* AFPCharacter::GetFootstepSound(TWeakObjectPtr<UPhysicalMaterial>* Surface)
-{
-	for (auto FootstepMapping : FootstepSettings.Mappings)
+	if (IsValid(FootstepSound))
 	{
-		if (FootstepMapping && FootstepMapping->GetPhysicalMaterial() == Surface->Get())
-		{
-			CurrentFootstepMapping = FootstepMapping;
-			FootstepSettings.CurrentStride = (CrouchPhase != ECrouchPhase::Standing) ? FootstepMapping->GetFootstepStride_Crouch() : bWantsToRun ? FootstepMapping->GetFootstepStride_Run() : FootstepMapping->GetFootstepStride_Walk();
-			return FootstepMapping->GetFootstepSounds()[FMath::RandRange(0, FootstepMapping->GetFootstepSounds().Num() - 1)];
-		}
+		const float VolumeMultiplier = CrouchPhase != ECrouchPhase::Standing ? FootstepSettings.CrouchVolumeMultiplier : 1.0f;
+
+		// The footstep audio subsystem decides whether it's worth a voice
+		if (UFirstPersonFootstepAudioSubsystem* FootstepAudio = GetWorld()->GetSubsystem<UFirstPersonFootstepAudioSubsystem>())
+			FootstepAudio->PlayFootstep(this, FootstepSound, FootstepLocation, VolumeMultiplier);
+		else
+			UGameplayStatics::PlaySoundAtLocation(this, FootstepSound, FootstepLocation, VolumeMultiplier);
 	}
 
-	UE_LOG(LogTemp, Warning, TEXT("No footstep sound"))
-	return nullptr;
+	LastFootstepLocation = FootstepLocation;
+#endif
 }
 
-void AFPCharacter::SetupInputBindings()
+bool AFPCharacter::FindBakedFootstepSurface(FVector& OutLocation, const UPhysicalMaterial*& OutSurface) const
 {
-	ActionMappings = Input->GetActionMappings();
-	AxisMappings = Input->GetAxisMappings();
+	// Only static floors are baked
+	const UPrimitiveComponent* Floor = GetMovementBase();
+	if (!Floor || Floor->Mobility != EComponentMobility::Static)
+		return false;
 
-	// Exit early if we already have inputs set
-	if (ActionMappings.Num() > 0 || AxisMappings.Num() > 0)
-	{
-		if (!bUseCustomKeyMappings)
-			ResetToDefaultInputBindings();
+	const UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>();
+	const FVector FeetLocation = GetActorLocation() - FVector(0.0f, 0.0f, GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+	if (!CharacterSubsystem || !CharacterSubsystem->SampleSurfaceMaps(FeetLocation, OutSurface))
+		return false;
 
-		return;
-	}
-	
-	ResetToDefaultInputBindings();
+	// Same as the location of a floor hit
+	OutLocation = GetActorLocation();
+	return true;
 }
 
-void AFPCharacter::ResetInputBindings()
+const FHitResult* AFPCharacter::FindFootstepFloor()
 {
-	for (const auto& Action : ActionMappings)
-		Input->RemoveActionMapping(Action);
+	// The movement component has already found the floor during this frame's movement update
+	const FFindFloorResult& CurrentFloor = GetCharacterMovement()->CurrentFloor;
+	if (GetCharacterMovement()->IsMovingOnGround() && CurrentFloor.bBlockingHit)
+		return &CurrentFloor.HitResult;
 
-	for (const auto& Axis : AxisMappings)
-		Input->RemoveAxisMapping(Axis);
+	GetCharacterMovement()->FindFloor(GetCapsuleComponent()->GetComponentLocation(), FloorResult, false);
+	INC_DWORD_STAT(STAT_FootstepFloorSweeps);
+	NumFootstepFloorSweeps++;
+
+	if (FloorResult.bBlockingHit)
+		INC_DWORD_STAT(STAT_FootstepFloorsFound);
+
+	return FloorResult.bBlockingHit ? &FloorResult.HitResult : nullptr;
 }
 
-void AFPCharacter::ResetToDefaultInputBindings()
+const UPhysicalMaterial* AFPCharacter::GetFloorSurface(const FHitResult& FloorHit)
 {
-	// Clear all the action and axis mappings
-	ResetInputBindings();
+	// Floor sweeps return the physical material when the capsule has bReturnMaterialOnMove set
+	if (const UPhysicalMaterial* HitSurface = FloorHit.PhysMaterial.Get())
+		return HitSurface;
 
-	// Populate the map with action and axis mappings
-	TArray<FName> ActionNames;
-	TArray<FName> AxisNames;
-	TArray<FKey> ActionKeys;
-	TArray<FKey> AxisKeys;
-	TMap<FKey, FName> ActionMap;
-	TMap<FKey, FName> AxisMap;
-	ActionMap.Add(EKeys::SpaceBar, FName("Jump"));
-	ActionMap.Add(EKeys::F, FName("Interact"));
-	ActionMap.Add(EKeys::Escape, FName("Escape"));
-	ActionMap.Add(EKeys::LeftShift, FName("Run"));
-	ActionMap.Add(EKeys::LeftControl, FName("Crouch"));
-	ActionMap.Add(EKeys::C, FName("Crouch"));
-	AxisMap.Add(EKeys::MouseX, FName("Turn"));
-	AxisMap.Add(EKeys::MouseY, FName("LookUp"));
-	AxisMap.Add(EKeys::W, FName("MoveForward"));
-	AxisMap.Add(EKeys::S, FName("MoveForward"));
-	AxisMap.Add(EKeys::A, FName("MoveRight"));
-	AxisMap.Add(EKeys::D, FName("MoveRight"));
+	UPrimitiveComponent* FloorComponent = FloorHit.GetComponent();
+	if (!FloorComponent)
+		return nullptr;
 
-	// Lambda function to set the new action mappings
-	const auto SetActionMapping = [&](const FName Name, const FKey Key)
-	{
-		FInputActionKeyMapping ActionMapping;
-		ActionMapping.ActionName = Name;
-		ActionMapping.Key = bUseCustomKeyMappings ? EKeys::NAME_KeyboardCategory : Key;
-		Input->AddActionMapping(ActionMapping);
-	};
+	// Without a face there is no material lookup to save
+	if (FloorHit.FaceIndex == INDEX_NONE)
+		return FloorComponent->BodyInstance.GetSimplePhysicalMaterial();
 
-	// Lambda function to set the new axis mappings
-	const auto SetAxisMapping = [&](const FName Name, const FKey Key, const float Scale)
+	for (const FFloorSurfaceCacheEntry& CacheEntry : FloorSurfaceCache)
 	{
-		FInputAxisKeyMapping AxisMapping;
-		AxisMapping.AxisName = Name;
-		AxisMapping.Key = bUseCustomKeyMappings ? EKeys::NAME_KeyboardCategory : Key;
-		AxisMapping.Scale = Scale;
-		Input->AddAxisMapping(AxisMapping);
-	};
+		if (CacheEntry.Component.Get() == FloorComponent && CacheEntry.FaceIndex == FloorHit.FaceIndex)
+			return CacheEntry.Surface.Get();
+	}
+
+	NumFootstepMaterialLookups++;
+
+	int32 SectionIndex;
+	const UMaterialInterface* Material = FloorComponent->GetMaterialFromCollisionFaceIndex(FloorHit.FaceIndex, SectionIndex);
+	const UPhysicalMaterial* Surface = Material ? Material->GetPhysicalMaterial() : FloorComponent->BodyInstance.GetSimplePhysicalMaterial();
+
+	FFloorSurfaceCacheEntry& CacheEntry = FloorSurfaceCache[NextFloorSurfaceCacheEntry];
+	CacheEntry.Component = FloorComponent;
+	CacheEntry.FaceIndex = FloorHit.FaceIndex;
+	CacheEntry.Surface = Surface;
+	NextFloorSurfaceCacheEntry = (NextFloorSurfaceCacheEntry + 1) % UE_ARRAY_COUNT(FloorSurfaceCache);
+
+	return Surface;
+}
 
-	// Loop through the entire ActionMap and assign action inputs
-	ActionMap.GenerateKeyArray(ActionKeys);
-	ActionMap.GenerateValueArray(ActionNames);
-	for (int32 i = 0; i < ActionMap.Num(); i++)
+USoundBase* AFPCharacter::GetFootstepSound(const UPhysicalMaterial* Surface)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GetFootstepSound);
+
+	const int32 Entry = FootstepTable.FindEntry(Surface);
+	if (Entry != INDEX_NONE)
 	{
-		SetActionMapping(ActionNames[i], ActionKeys[i]);
+		CurrentFootstepMapping = FootstepTable.GetMapping(Entry);
+
+		const EFootstepStance Stance = (CrouchPhase != ECrouchPhase::Standing) ? EFootstepStance::Crouch : IsRunning() ? EFootstepStance::Run : EFootstepStance::Walk;
+		FootstepSettings.CurrentStride = FootstepTable.GetStride(Entry, Stance);
+
+		if (USoundBase* Sound = FootstepTable.PickSound(Entry, FootstepRandom))
+			return Sound;
+
+		// First time on this surface, load its sounds for the next steps
+		LoadFootstepSounds(Entry);
+
+		return FootstepSettings.FallbackSound;
 	}
 
-	// Loop through the entire AxisMap and assign axis inputs
-	AxisMap.GenerateKeyArray(AxisKeys);
-	AxisMap.GenerateValueArray(AxisNames);
-	for (int32 i = 0; i < AxisMap.Num(); i++)
-	{
-		const bool bIsNegativeScale = AxisKeys[i] == EKeys::S || AxisKeys[i] == EKeys::A || AxisKeys[i] == EKeys::MouseY;
+	// Only once per surface, this runs for every step
+	bool bAlreadyReported = false;
+	UnmappedFootstepSurfaces.Add(FObjectKey(Surface), &bAlreadyReported);
+	if (!bAlreadyReported)
+		UE_LOG(LogFirstPersonCharacter, Warning, TEXT("%s: no footstep mapping for %s"), *GetName(), Surface ? *Surface->GetName() : TEXT("floors without a physical material"))
+
+	return nullptr;
+}
 
-		SetAxisMapping(AxisNames[i], AxisKeys[i], bIsNegativeScale ? -1.0f : 1.0f);
+void AFPCharacter::LoadLevelFootstepSounds()
+{
+	const UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>();
+	if (!CharacterSubsystem)
+		return;
+
+	TArray<const UPhysicalMaterial*> Surfaces;
+	CharacterSubsystem->GetSurfaceMapSurfaces(Surfaces);
+
+	for (const UPhysicalMaterial* Surface : Surfaces)
+	{
+		const int32 Entry = FootstepTable.FindEntry(Surface);
+		if (Entry != INDEX_NONE)
+			LoadFootstepSounds(Entry);
 	}
+}
 
-	// Save to input config file
-	Input->SaveKeyMappings();
+void AFPCharacter::LoadFootstepSounds(const int32 Entry)
+{
+	UFirstPersonFootstepAudioSubsystem* FootstepAudio = GetWorld()->GetSubsystem<UFirstPersonFootstepAudioSubsystem>();
+	if (!FootstepAudio)
+		return;
 
-	// Update in Project Settings -> Engine -> Input
-	Input->ForceRebuildKeymaps();
+	if (const UFirstPersonFootstepData* Mapping = FootstepTable.GetMapping(Entry))
+		FootstepAudio->LoadFootstepSounds(Mapping);
+	else
+		FootstepAudio->LoadFootstepSounds(FootstepTable.GetSource(Entry), FootstepTable.GetSounds(Entry));
+}
+
+void AFPCharacter::SetupInputBindings()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ApplyInputBindings);
+
+	// Custom key mappings come from Project Settings -> Engine -> Input, the defaults only fill in what's missing there
+	const APlayerController* OwningPlayerController = Cast<APlayerController>(Controller);
+	if (OwningPlayerController && OwningPlayerController->PlayerInput)
+		FFirstPersonInputProfile::GetDefault().ApplyTo(OwningPlayerController->PlayerInput, bUseCustomKeyMappings);
+}
+
+void AFPCharacter::ResetToDefaultInputBindings()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ApplyInputBindings);
+
+	const APlayerController* OwningPlayerController = Cast<APlayerController>(Controller);
+	if (OwningPlayerController && OwningPlayerController->PlayerInput)
+		FFirstPersonInputProfile::GetDefault().ApplyTo(OwningPlayerController->PlayerInput, false);
 }
 
 void AFPCharacter::AddControllerYawInput(const float Value)
 {
-	return Super::AddControllerYawInput(Value * Camera.SensitivityX * GetWorld()->GetDeltaSeconds());
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::Turn, Value);
+
+	Super::AddControllerYawInput(Value * Camera.SensitivityX * LookSensitivityScale);
 }
 
 void AFPCharacter::AddControllerPitchInput(const float Value)
 {
-	Super::AddControllerPitchInput(Value * Camera.SensitivityY * GetWorld()->GetDeltaSeconds());
+	if (InputRecorder)
+		InputRecorder->Record(EFirstPersonInputEvent::LookUp, Value);
+
+	Super::AddControllerPitchInput(Value * Camera.SensitivityY * LookSensitivityScale);
 }
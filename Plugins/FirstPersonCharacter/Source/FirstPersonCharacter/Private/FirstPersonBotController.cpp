@@ -0,0 +1,93 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonBotController.h"
+#include "FPCharacter.h"
+
+AFirstPersonBotController::AFirstPersonBotController()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	// We turn the control rotation ourselves
+	bSetControlRotationFromPawnOrientation = false;
+
+	Random.GenerateNewSeed();
+}
+
+void AFirstPersonBotController::SetRandomSeed(const int32 Seed)
+{
+	Random.Initialize(Seed);
+	StaggerCrouchSchedule();
+}
+
+void AFirstPersonBotController::SetCrouchSchedule(const float Interval, const float Duration)
+{
+	CrouchInterval = FMath::Max(Interval, 0.0f);
+	CrouchDuration = FMath::Max(Duration, 0.0f);
+	StaggerCrouchSchedule();
+}
+
+void AFirstPersonBotController::StaggerCrouchSchedule()
+{
+	// Spread the bots over the schedule, so they don't all crouch in the same frame
+	CrouchScheduleTime = Random.FRandRange(0.0f, CrouchInterval);
+}
+
+void AFirstPersonBotController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	WanderYaw = GetControlRotation().Yaw;
+	TimeUntilDecision = 0.0f;
+	StaggerCrouchSchedule();
+}
+
+void AFirstPersonBotController::Tick(const float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	AFPCharacter* Bot = GetPawn<AFPCharacter>();
+	if (!Bot)
+		return;
+
+	// Walking into a wall, try somewhere else
+	const bool bStuck = bWandering && Bot->GetVelocity().SizeSquared2D() < FMath::Square(10.0f);
+	TimeStuck = bStuck ? TimeStuck + DeltaSeconds : 0.0f;
+	if (TimeStuck > 0.5f)
+	{
+		WanderYaw = FRotator::NormalizeAxis(WanderYaw + Random.FRandRange(90.0f, 270.0f));
+		TimeStuck = 0.0f;
+	}
+
+	TimeUntilDecision -= DeltaSeconds;
+	if (TimeUntilDecision <= 0.0f)
+		Decide(Bot);
+
+	if (CrouchInterval > 0.0f)
+	{
+		CrouchScheduleTime = FMath::Fmod(CrouchScheduleTime + DeltaSeconds, CrouchInterval);
+		Bot->SetCrouchIntent(CrouchScheduleTime < CrouchDuration);
+	}
+
+	const float YawDelta = FMath::FindDeltaAngleDegrees(GetControlRotation().Yaw, WanderYaw);
+	const float MaxYawStep = TurnRate * DeltaSeconds;
+	Bot->AddLookIntent(FVector2D(FMath::Clamp(YawDelta, -MaxYawStep, MaxYawStep), 0.0f));
+
+	// Movement input is consumed every frame, like axis bindings
+	if (bWandering)
+		Bot->AddMoveIntent(FVector2D(1.0f, 0.0f));
+}
+
+void AFirstPersonBotController::Decide(AFPCharacter* Bot)
+{
+	TimeUntilDecision = Random.FRandRange(MinDecisionTime, FMath::Max(MinDecisionTime, MaxDecisionTime));
+
+	bWandering = Random.FRand() >= IdleChance;
+	WanderYaw = Random.FRandRange(-180.0f, 180.0f);
+
+	Bot->SetRunIntent(bWandering && Random.FRand() < RunChance);
+	if (CrouchInterval <= 0.0f)
+		Bot->SetCrouchIntent(Random.FRand() < CrouchChance);
+
+	// Released again at the next decision, the character only jumps once per press
+	Bot->SetJumpIntent(Random.FRand() < JumpChance);
+}
@@ -0,0 +1,109 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonBotSpawner.h"
+#include "FirstPersonBotController.h"
+#include "FirstPersonCharacter.h"
+#include "FPCharacter.h"
+
+#include "Components/CapsuleComponent.h"
+#include "Components/SceneComponent.h"
+
+#include "Engine/World.h"
+
+#include "GameFramework/Controller.h"
+
+AFirstPersonBotSpawner::AFirstPersonBotSpawner()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(FName("RootComponent"));
+
+	BotClass = AFPCharacter::StaticClass();
+	BotControllerClass = AFirstPersonBotController::StaticClass();
+}
+
+void AFirstPersonBotSpawner::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// The bots replicate to clients like any other character
+	if (HasAuthority() && BotClass && BotControllerClass && NumBots > 0)
+	{
+		Random.Initialize(RandomSeed);
+		SetActorTickEnabled(true);
+	}
+}
+
+void AFirstPersonBotSpawner::Tick(const float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	for (int32 i = 0; i < BotsPerFrame && IsSpawning(); i++)
+		SpawnBot();
+
+	if (!IsSpawning())
+	{
+		UE_LOG(LogFirstPersonCharacter, Log, TEXT("%s spawned %d of %d bots"), *GetName(), Bots.Num(), NumBots)
+		SetActorTickEnabled(false);
+	}
+}
+
+void AFirstPersonBotSpawner::SpawnBot()
+{
+	const int32 BotIndex = NumSpawnAttempts++;
+
+	// Uniform over the disc around the spawner
+	const float Distance = SpawnRadius * FMath::Sqrt(Random.FRand());
+	const float Angle = Random.FRandRange(0.0f, 2.0f * PI);
+	const FVector SearchLocation = GetActorLocation() + FVector(FMath::Cos(Angle) * Distance, FMath::Sin(Angle) * Distance, 0.0f);
+	const float Yaw = Random.FRandRange(-180.0f, 180.0f);
+
+	// Only static geometry counts as floor, bots spawned earlier don't
+	FHitResult FloorHit;
+	const FVector SearchEnd = SearchLocation - FVector(0.0f, 0.0f, FloorSearchDepth);
+	const FCollisionObjectQueryParams FloorObjectTypes(FCollisionObjectQueryParams::InitType::AllStaticObjects);
+	if (!GetWorld()->LineTraceSingleByObjectType(FloorHit, SearchLocation, SearchEnd, FloorObjectTypes, FCollisionQueryParams(SCENE_QUERY_STAT(BotSpawnerFloor), false, this)))
+		return;
+
+	const float HalfHeight = BotClass->GetDefaultObject<AFPCharacter>()->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	const FTransform SpawnTransform(FRotator(0.0f, Yaw, 0.0f), FloorHit.ImpactPoint + FVector(0.0f, 0.0f, HalfHeight));
+
+	AFPCharacter* Bot = GetWorld()->SpawnActorDeferred<AFPCharacter>(BotClass, SpawnTransform, this, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding);
+	if (!Bot)
+		return;
+
+	// Not the player's, the bot controller takes it as soon as it's spawned
+	Bot->AutoPossessPlayer = EAutoReceiveInput::Disabled;
+	Bot->AutoReceiveInput = EAutoReceiveInput::Disabled;
+	Bot->AutoPossessAI = EAutoPossessAI::Spawned;
+	Bot->AIControllerClass = BotControllerClass;
+
+	if (FootstepMappings.Num() > 0)
+		Bot->FootstepSettings.Mappings = FootstepMappings;
+
+	Bot->FinishSpawning(SpawnTransform);
+	if (Bot->IsPendingKill())
+		return;
+
+	if (AFirstPersonBotController* BotController = Bot->GetController<AFirstPersonBotController>())
+		BotController->SetRandomSeed(RandomSeed + BotIndex);
+
+	Bots.Add(Bot);
+}
+
+void AFirstPersonBotSpawner::DestroyBots()
+{
+	for (AFPCharacter* Bot : Bots)
+	{
+		if (!IsValid(Bot))
+			continue;
+
+		if (AController* BotController = Bot->GetController())
+			BotController->Destroy();
+
+		Bot->Destroy();
+	}
+
+	Bots.Reset();
+}
@@ -0,0 +1,169 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonCameraShakeComponent.h"
+#include "FirstPersonCharacterStats.h"
+#include "FirstPersonCharacterTrace.h"
+#include "FPCharacter.h"
+
+#include "Camera/CameraShakeBase.h"
+#include "Camera/PlayerCameraManager.h"
+
+#include "GameFramework/PlayerController.h"
+
+#include "GameplayCameras/Public/MatineeCameraShake.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Camera Shakes Started"), STAT_CameraShakesStarted, STATGROUP_FirstPersonCharacter);
+
+UFirstPersonCameraShakeComponent::UFirstPersonCameraShakeComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	LocomotionState = ELocomotionState::Idle;
+}
+
+void UFirstPersonCameraShakeComponent::UpdateLocomotionState(const ELocomotionState NewState, const FCameraShakes& Shakes)
+{
+	if (!GetLocalCameraManager())
+		return;
+
+	if (bHasLocomotionState && NewState == LocomotionState)
+	{
+		// Only restart shakes that have run out (non-looping shake assets)
+		const bool bBaseShakeExpired = BaseShake && !IsShakePlaying(BaseShake);
+		const bool bRunShakeExpired = RunShake && !IsShakePlaying(RunShake);
+		if (!bBaseShakeExpired && !bRunShakeExpired)
+			return;
+	}
+
+	TRACE_FIRSTPERSON_SHAKE_TRANSITION(GetOwner(), NewState);
+
+	// Blend out the previous shakes, the new ones blend in on their own
+	StopLocomotionShakes(false);
+	StartLocomotionShakes(NewState, Shakes);
+
+	LocomotionState = NewState;
+	bHasLocomotionState = true;
+}
+
+void UFirstPersonCameraShakeComponent::PlayOneShot(const TSubclassOf<UCameraShakeBase> Shake, const float Scale)
+{
+	if (Shake && GetLocalCameraManager())
+		StartShake(Shake, Scale);
+}
+
+void UFirstPersonCameraShakeComponent::StopLocomotionShakes(const bool bImmediately)
+{
+	StopShake(BaseShake, bImmediately);
+	StopShake(RunShake, bImmediately);
+
+	bHasLocomotionState = false;
+}
+
+float UFirstPersonCameraShakeComponent::GetLocomotionShakeTimeRemaining() const
+{
+	return FMath::Min(GetShakeTimeRemaining(BaseShake, BaseShakeStartTime), GetShakeTimeRemaining(RunShake, RunShakeStartTime));
+}
+
+void UFirstPersonCameraShakeComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopLocomotionShakes(true);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+APlayerCameraManager* UFirstPersonCameraShakeComponent::GetLocalCameraManager()
+{
+	const APawn* OwningPawn = Cast<APawn>(GetOwner());
+	if (!OwningPawn || !OwningPawn->IsLocallyControlled())
+		return nullptr;
+
+	const APlayerController* PlayerController = OwningPawn->GetController<APlayerController>();
+	APlayerCameraManager* NewCameraManager = PlayerController ? PlayerController->PlayerCameraManager : nullptr;
+
+	// The shake instances belong to the previous camera manager, so forget about them
+	if (NewCameraManager != CameraManager)
+	{
+		BaseShake = nullptr;
+		RunShake = nullptr;
+		bHasLocomotionState = false;
+		CameraManager = NewCameraManager;
+	}
+
+	return CameraManager;
+}
+
+void UFirstPersonCameraShakeComponent::StartLocomotionShakes(const ELocomotionState State, const FCameraShakes& Shakes)
+{
+	BaseShakeStartTime = GetWorld()->GetTimeSeconds();
+	RunShakeStartTime = BaseShakeStartTime;
+
+	switch (State)
+	{
+		case ELocomotionState::Idle:
+		case ELocomotionState::Airborne:
+		{
+			// Breathing shake
+			if (Shakes.IdleShake)
+				BaseShake = StartShake(Shakes.IdleShake, 1.0f);
+			break;
+		}
+
+		case ELocomotionState::Running:
+		{
+			if (Shakes.RunShake)
+				RunShake = StartShake(Shakes.RunShake, 1.0f);
+
+			// Running is layered on top of the walking shake
+			if (Shakes.WalkShake)
+				BaseShake = StartShake(Shakes.WalkShake, 2.0f);
+			break;
+		}
+
+		case ELocomotionState::Walking:
+		{
+			if (Shakes.WalkShake)
+				BaseShake = StartShake(Shakes.WalkShake, 2.0f);
+			break;
+		}
+	}
+}
+
+UCameraShakeBase* UFirstPersonCameraShakeComponent::StartShake(const TSubclassOf<UCameraShakeBase> Shake, const float Scale)
+{
+	NumShakesStarted++;
+	INC_DWORD_STAT(STAT_CameraShakesStarted);
+	CSV_CUSTOM_STAT(FirstPersonCharacter, CameraShakesStarted, 1, ECsvCustomStatOp::Accumulate);
+
+	return CameraManager->StartCameraShake(Shake, Scale);
+}
+
+void UFirstPersonCameraShakeComponent::StopShake(UCameraShakeBase*& Shake, const bool bImmediately)
+{
+	if (Shake && CameraManager && IsShakePlaying(Shake))
+		CameraManager->StopCameraShake(Shake, bImmediately);
+
+	Shake = nullptr;
+}
+
+bool UFirstPersonCameraShakeComponent::IsShakePlaying(const UCameraShakeBase* Shake)
+{
+	return IsValid(Shake) && !Shake->IsFinished();
+}
+
+float UFirstPersonCameraShakeComponent::GetShakeTimeRemaining(const UCameraShakeBase* Shake, const float StartTime) const
+{
+	if (!IsShakePlaying(Shake))
+		return MAX_flt;
+
+	// A negative oscillation duration loops forever
+	if (const UMatineeCameraShake* MatineeShake = Cast<UMatineeCameraShake>(Shake))
+		return MatineeShake->OscillationDuration < 0.0f ? MAX_flt : MatineeShake->OscillatorTimeRemaining;
+
+	// Sequence and pattern shakes tell their duration, but not how far along they are
+	FCameraShakeInfo ShakeInfo;
+	Shake->GetShakeInfo(ShakeInfo);
+	if (!ShakeInfo.Duration.IsFixed())
+		return MAX_flt;
+
+	return FMath::Max(ShakeInfo.Duration.Get() - (GetWorld()->GetTimeSeconds() - StartTime), 0.0f);
+}
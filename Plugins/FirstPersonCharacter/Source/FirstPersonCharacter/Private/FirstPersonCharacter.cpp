@@ -1,9 +1,14 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "FirstPersonCharacter.h"
+#include "FirstPersonCharacterStats.h"
 
 #define LOCTEXT_NAMESPACE "FFirstPersonCharacterModule"
 
+DEFINE_LOG_CATEGORY(LogFirstPersonCharacter);
+
+CSV_DEFINE_CATEGORY_MODULE(FIRSTPERSONCHARACTER_API, FirstPersonCharacter, false);
+
 void FFirstPersonCharacterModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
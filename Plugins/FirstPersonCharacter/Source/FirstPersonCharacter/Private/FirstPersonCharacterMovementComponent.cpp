@@ -0,0 +1,159 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonCharacterMovementComponent.h"
+#include "FirstPersonCharacterStats.h"
+#include "FPCharacter.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Client Movement Corrections"), STAT_ClientMovementCorrections, STATGROUP_FirstPersonCharacter);
+
+namespace
+{
+	// Run and crouch intent in the custom bits of the compressed flags
+	const uint8 FLAG_WantsToRun = FSavedMove_Character::FLAG_Custom_0;
+	const uint8 FLAG_WantsToCrouchStance = FSavedMove_Character::FLAG_Custom_1;
+}
+
+/**
+ * A saved move that remembers the run and crouch intent, and the locomotion state the move started from so replays begin where the original move did
+ */
+class FSavedMove_FirstPerson : public FSavedMove_Character
+{
+public:
+	typedef FSavedMove_Character Super;
+
+	void Clear() override
+	{
+		Super::Clear();
+
+		bSavedWantsToRun = false;
+		bSavedWantsToCrouch = false;
+		StartLocomotion = FFirstPersonLocomotionState();
+	}
+
+	uint8 GetCompressedFlags() const override
+	{
+		uint8 Flags = Super::GetCompressedFlags();
+
+		if (bSavedWantsToRun)
+			Flags |= FLAG_WantsToRun;
+
+		if (bSavedWantsToCrouch)
+			Flags |= FLAG_WantsToCrouchStance;
+
+		return Flags;
+	}
+
+	bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override
+	{
+		const FSavedMove_FirstPerson* NewFirstPersonMove = static_cast<const FSavedMove_FirstPerson*>(NewMove.Get());
+		if (bSavedWantsToRun != NewFirstPersonMove->bSavedWantsToRun || bSavedWantsToCrouch != NewFirstPersonMove->bSavedWantsToCrouch)
+			return false;
+
+		// A combined move steps the transition once with the summed time, keep them apart while the capsule is changing
+		if (StartLocomotion.CrouchPhase == ECrouchPhase::InTransition || NewFirstPersonMove->StartLocomotion.CrouchPhase == ECrouchPhase::InTransition)
+			return false;
+
+		return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+	}
+
+	void SetMoveFor(ACharacter* InCharacter, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) override
+	{
+		Super::SetMoveFor(InCharacter, InDeltaTime, NewAccel, ClientData);
+
+		if (const AFPCharacter* FirstPersonCharacter = Cast<AFPCharacter>(InCharacter))
+		{
+			bSavedWantsToRun = FirstPersonCharacter->bWantsToRun;
+			bSavedWantsToCrouch = FirstPersonCharacter->bWantsToCrouch;
+			StartLocomotion = FirstPersonCharacter->CaptureLocomotion();
+		}
+	}
+
+	void PrepMoveFor(ACharacter* InCharacter) override
+	{
+		Super::PrepMoveFor(InCharacter);
+
+		// Replays restore the state this move started from, the intents come back through the compressed flags
+		if (AFPCharacter* FirstPersonCharacter = Cast<AFPCharacter>(InCharacter))
+			FirstPersonCharacter->ApplyLocomotion(StartLocomotion, true);
+	}
+
+	bool bSavedWantsToRun = false;
+	bool bSavedWantsToCrouch = false;
+	FFirstPersonLocomotionState StartLocomotion;
+};
+
+class FNetworkPredictionData_Client_FirstPerson : public FNetworkPredictionData_Client_Character
+{
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	explicit FNetworkPredictionData_Client_FirstPerson(const UCharacterMovementComponent& ClientMovement)
+		: Super(ClientMovement)
+	{
+	}
+
+	FSavedMovePtr AllocateNewMove() override
+	{
+		return FSavedMovePtr(new FSavedMove_FirstPerson());
+	}
+};
+
+FNetworkPredictionData_Client* UFirstPersonCharacterMovementComponent::GetPredictionData_Client() const
+{
+	if (!ClientPredictionData)
+	{
+		UFirstPersonCharacterMovementComponent* MutableThis = const_cast<UFirstPersonCharacterMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_FirstPerson(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+void UFirstPersonCharacterMovementComponent::UpdateFromCompressedFlags(const uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	// The locomotion update picks up a changed crouch intent on its own
+	if (AFPCharacter* FirstPersonCharacter = Cast<AFPCharacter>(CharacterOwner))
+	{
+		FirstPersonCharacter->bWantsToRun = (Flags & FLAG_WantsToRun) != 0;
+		FirstPersonCharacter->bWantsToCrouch = (Flags & FLAG_WantsToCrouchStance) != 0;
+	}
+}
+
+bool UFirstPersonCharacterMovementComponent::ClientUpdatePositionAfterServerUpdate()
+{
+	AFPCharacter* FirstPersonCharacter = Cast<AFPCharacter>(CharacterOwner);
+	if (!FirstPersonCharacter)
+		return Super::ClientUpdatePositionAfterServerUpdate();
+
+	// Replayed moves set the intents from their flags, put back what the player wants right now, like the engine does for bWantsToCrouch
+	const bool bRealWantsToRun = FirstPersonCharacter->bWantsToRun;
+	const bool bRealWantsToCrouch = FirstPersonCharacter->bWantsToCrouch;
+
+	const bool bResult = Super::ClientUpdatePositionAfterServerUpdate();
+
+	FirstPersonCharacter->bWantsToRun = bRealWantsToRun;
+	FirstPersonCharacter->bWantsToCrouch = bRealWantsToCrouch;
+
+	return bResult;
+}
+
+void UFirstPersonCharacterMovementComponent::UpdateCharacterStateBeforeMovement(const float DeltaSeconds)
+{
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+
+	// Runs for every move on the owning client, the server and during replays, with the same intents and delta time
+	AFPCharacter* FirstPersonCharacter = Cast<AFPCharacter>(CharacterOwner);
+	if (FirstPersonCharacter && FirstPersonCharacter->IsLocomotionPredicted())
+		FirstPersonCharacter->UpdatePredictedLocomotion(DeltaSeconds);
+}
+
+void UFirstPersonCharacterMovementComponent::OnClientCorrectionReceived(FNetworkPredictionData_Client_Character& ClientData, const float TimeStamp, const FVector NewLocation, const FVector NewVelocity, UPrimitiveComponent* NewBase, const FName NewBaseBoneName, const bool bHasBase, const bool bBaseRelativePosition, const uint8 ServerMovementMode)
+{
+	Super::OnClientCorrectionReceived(ClientData, TimeStamp, NewLocation, NewVelocity, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode);
+
+	NumClientCorrections++;
+	INC_DWORD_STAT(STAT_ClientMovementCorrections);
+	CSV_CUSTOM_STAT(FirstPersonCharacter, ClientMovementCorrections, 1, ECsvCustomStatOp::Accumulate);
+}
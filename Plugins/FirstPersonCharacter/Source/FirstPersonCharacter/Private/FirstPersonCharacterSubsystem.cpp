@@ -0,0 +1,435 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonCharacterSubsystem.h"
+#include "FirstPersonCharacterStats.h"
+#include "FirstPersonSurfaceMap.h"
+#include "FirstPersonSurfaceMapActor.h"
+
+#include "Async/ParallelFor.h"
+
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Batched Locomotion"), STAT_BatchedLocomotion, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Significance"), STAT_FirstPersonSignificance, STATGROUP_FirstPersonCharacter);
+DECLARE_CYCLE_STAT(TEXT("Head Bob"), STAT_HeadBob, STATGROUP_FirstPersonCharacter);
+
+namespace
+{
+	enum ELocomotionFlags : uint8
+	{
+		Locomotion_CrouchIntent = 1 << 0,
+		Locomotion_RunIntent = 1 << 1,
+		Locomotion_StandUpBlocked = 1 << 2,
+		Locomotion_Awake = 1 << 3,
+		Locomotion_Changed = 1 << 4
+	};
+
+	// Below this many characters, spreading the work over threads costs more than it saves
+	const int32 MinParallelLocomotionBatch = 64;
+}
+
+int32 UFirstPersonCharacterSubsystem::RegisterHeadBob(AFPCharacter* Character)
+{
+	const int32 Handle = HeadBobCharacters.Add(Character);
+	ResizeHeadBobArrays(HeadBobCharacters.Num());
+
+	BobPhases[Handle] = 0.0f;
+	BreathingPhases[Handle] = 0.0f;
+	BobWeights[Handle] = 0.0f;
+
+	return Handle;
+}
+
+void UFirstPersonCharacterSubsystem::UnregisterHeadBob(const int32 Handle)
+{
+	if (!HeadBobCharacters.IsValidIndex(Handle))
+		return;
+
+	// Move the last character into the freed slot to keep the arrays dense
+	const int32 LastIndex = HeadBobCharacters.Num() - 1;
+	if (Handle != LastIndex)
+	{
+		HeadBobCharacters[Handle] = HeadBobCharacters[LastIndex];
+		HeadBobCharacters[Handle]->HeadBobHandle = Handle;
+
+		BobPhases[Handle] = BobPhases[LastIndex];
+		BreathingPhases[Handle] = BreathingPhases[LastIndex];
+		BobWeights[Handle] = BobWeights[LastIndex];
+	}
+
+	HeadBobCharacters.RemoveAt(LastIndex, 1, false);
+	ResizeHeadBobArrays(HeadBobCharacters.Num());
+}
+
+int32 UFirstPersonCharacterSubsystem::RegisterBatchedUpdate(AFPCharacter* Character)
+{
+	const int32 Handle = BatchedCharacters.Add(Character);
+	const int32 NewNum = BatchedCharacters.Num();
+
+	CrouchPhases.SetNum(NewNum, false);
+	CurrentWalkSpeeds.SetNum(NewNum, false);
+	MaxWalkSpeeds.SetNum(NewNum, false);
+	CrouchHalfHeights.SetNum(NewNum, false);
+	CameraLocations.SetNum(NewNum, false);
+	LocomotionParams.SetNum(NewNum, false);
+	LocomotionFlags.SetNum(NewNum, false);
+	PendingDeltaTimes.SetNum(NewNum, false);
+	TickIntervals.SetNum(NewNum, false);
+	DueHandles.Reserve(NewNum);
+
+	SetBatchedLocomotion(Handle, Character->CaptureLocomotion());
+	LocomotionParams[Handle] = Character->GetLocomotionParams();
+	LocomotionFlags[Handle] = (Character->bWantsToCrouch ? Locomotion_CrouchIntent : 0)
+		| (Character->bWantsToRun ? Locomotion_RunIntent : 0)
+		| (Character->bLocomotionAwake ? Locomotion_Awake : 0);
+	PendingDeltaTimes[Handle] = 0.0f;
+	TickIntervals[Handle] = Character->SignificanceTickInterval;
+
+	return Handle;
+}
+
+void UFirstPersonCharacterSubsystem::UnregisterBatchedUpdate(const int32 Handle)
+{
+	if (!BatchedCharacters.IsValidIndex(Handle))
+		return;
+
+	// Move the last character into the freed slot to keep the arrays dense
+	const int32 LastIndex = BatchedCharacters.Num() - 1;
+	if (Handle != LastIndex)
+	{
+		BatchedCharacters[Handle] = BatchedCharacters[LastIndex];
+		BatchedCharacters[Handle]->BatchedUpdateHandle = Handle;
+
+		CrouchPhases[Handle] = CrouchPhases[LastIndex];
+		CurrentWalkSpeeds[Handle] = CurrentWalkSpeeds[LastIndex];
+		MaxWalkSpeeds[Handle] = MaxWalkSpeeds[LastIndex];
+		CrouchHalfHeights[Handle] = CrouchHalfHeights[LastIndex];
+		CameraLocations[Handle] = CameraLocations[LastIndex];
+		LocomotionParams[Handle] = LocomotionParams[LastIndex];
+		LocomotionFlags[Handle] = LocomotionFlags[LastIndex];
+		PendingDeltaTimes[Handle] = PendingDeltaTimes[LastIndex];
+		TickIntervals[Handle] = TickIntervals[LastIndex];
+	}
+
+	BatchedCharacters.RemoveAt(LastIndex, 1, false);
+	CrouchPhases.RemoveAt(LastIndex, 1, false);
+	CurrentWalkSpeeds.RemoveAt(LastIndex, 1, false);
+	MaxWalkSpeeds.RemoveAt(LastIndex, 1, false);
+	CrouchHalfHeights.RemoveAt(LastIndex, 1, false);
+	CameraLocations.RemoveAt(LastIndex, 1, false);
+	LocomotionParams.RemoveAt(LastIndex, 1, false);
+	LocomotionFlags.RemoveAt(LastIndex, 1, false);
+	PendingDeltaTimes.RemoveAt(LastIndex, 1, false);
+	TickIntervals.RemoveAt(LastIndex, 1, false);
+}
+
+void UFirstPersonCharacterSubsystem::WakeBatchedUpdate(const int32 Handle, const bool bCrouchIntent, const bool bRunIntent)
+{
+	if (!LocomotionFlags.IsValidIndex(Handle))
+		return;
+
+	uint8& Flags = LocomotionFlags[Handle];
+	Flags &= ~(Locomotion_CrouchIntent | Locomotion_RunIntent);
+	Flags |= Locomotion_Awake | (bCrouchIntent ? Locomotion_CrouchIntent : 0) | (bRunIntent ? Locomotion_RunIntent : 0);
+}
+
+void UFirstPersonCharacterSubsystem::SetBatchedTickInterval(const int32 Handle, const float TickInterval)
+{
+	if (TickIntervals.IsValidIndex(Handle))
+		TickIntervals[Handle] = TickInterval;
+}
+
+FFirstPersonLocomotionState UFirstPersonCharacterSubsystem::GetBatchedLocomotion(const int32 Handle) const
+{
+	FFirstPersonLocomotionState State;
+	State.CrouchPhase = CrouchPhases[Handle];
+	State.CurrentWalkSpeed = CurrentWalkSpeeds[Handle];
+	State.MaxWalkSpeed = MaxWalkSpeeds[Handle];
+	State.CrouchHalfHeight = CrouchHalfHeights[Handle];
+	State.CameraLocation = CameraLocations[Handle];
+	return State;
+}
+
+void UFirstPersonCharacterSubsystem::SetBatchedLocomotion(const int32 Handle, const FFirstPersonLocomotionState& State)
+{
+	CrouchPhases[Handle] = State.CrouchPhase;
+	CurrentWalkSpeeds[Handle] = State.CurrentWalkSpeed;
+	MaxWalkSpeeds[Handle] = State.MaxWalkSpeed;
+	CrouchHalfHeights[Handle] = State.CrouchHalfHeight;
+	CameraLocations[Handle] = State.CameraLocation;
+}
+
+void UFirstPersonCharacterSubsystem::RegisterSignificance(AFPCharacter* Character)
+{
+	SignificanceCharacters.AddUnique(Character);
+
+	// Score the new character right away
+	TimeUntilSignificanceUpdate = 0.0f;
+}
+
+void UFirstPersonCharacterSubsystem::UnregisterSignificance(AFPCharacter* Character)
+{
+	SignificanceCharacters.RemoveSwap(Character);
+}
+
+void UFirstPersonCharacterSubsystem::RegisterSurfaceMap(AFirstPersonSurfaceMapActor* SurfaceMapActor)
+{
+	SurfaceMaps.AddUnique(SurfaceMapActor);
+	OnSurfaceMapsChanged.Broadcast();
+}
+
+void UFirstPersonCharacterSubsystem::UnregisterSurfaceMap(AFirstPersonSurfaceMapActor* SurfaceMapActor)
+{
+	SurfaceMaps.RemoveSwap(SurfaceMapActor);
+	OnSurfaceMapsChanged.Broadcast();
+}
+
+bool UFirstPersonCharacterSubsystem::SampleSurfaceMaps(const FVector& Location, const UPhysicalMaterial*& OutSurface) const
+{
+	for (const AFirstPersonSurfaceMapActor* SurfaceMapActor : SurfaceMaps)
+	{
+		if (SurfaceMapActor->SurfaceMap->Sample(Location, SurfaceMapActor->MaxHeightDifference, OutSurface))
+			return true;
+	}
+
+	return false;
+}
+
+void UFirstPersonCharacterSubsystem::GetSurfaceMapSurfaces(TArray<const UPhysicalMaterial*>& OutSurfaces) const
+{
+	for (const AFirstPersonSurfaceMapActor* SurfaceMapActor : SurfaceMaps)
+	{
+		for (const UPhysicalMaterial* Surface : SurfaceMapActor->SurfaceMap->GetSurfaces())
+			OutSurfaces.AddUnique(Surface);
+	}
+}
+
+void UFirstPersonCharacterSubsystem::Tick(const float DeltaTime)
+{
+	if (SignificanceCharacters.Num() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_FirstPersonSignificance);
+		UpdateSignificance(DeltaTime);
+	}
+
+	if (BatchedCharacters.Num() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_BatchedLocomotion);
+		CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, BatchedLocomotion);
+		UpdateLocomotionBatch(DeltaTime);
+	}
+
+	if (HeadBobCharacters.Num() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_HeadBob);
+		CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, HeadBob);
+		GatherHeadBob(DeltaTime);
+		EvaluateHeadBob();
+		ApplyHeadBob();
+	}
+}
+
+ETickableTickType UFirstPersonCharacterSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFirstPersonCharacterSubsystem::IsTickable() const
+{
+	return HeadBobCharacters.Num() > 0 || BatchedCharacters.Num() > 0 || SignificanceCharacters.Num() > 0;
+}
+
+TStatId UFirstPersonCharacterSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFirstPersonCharacterSubsystem, STATGROUP_Tickables);
+}
+
+void UFirstPersonCharacterSubsystem::UpdateLocomotionBatch(const float DeltaTime)
+{
+	// Pick everyone whose update is due. Resting characters cost nothing until an event wakes them
+	DueHandles.Reset();
+	for (int32 Handle = 0; Handle < BatchedCharacters.Num(); Handle++)
+	{
+		if ((LocomotionFlags[Handle] & Locomotion_Awake) == 0)
+			continue;
+
+		PendingDeltaTimes[Handle] += DeltaTime;
+		if (PendingDeltaTimes[Handle] >= TickIntervals[Handle])
+			DueHandles.Add(Handle);
+	}
+
+	// Clearance checks talk to other subsystems, so they stay on the game thread. Only held crouches being released need one
+	for (const int32 Handle : DueHandles)
+	{
+		uint8& Flags = LocomotionFlags[Handle];
+		const bool bReleasingCrouch = CrouchPhases[Handle] != ECrouchPhase::Standing && (Flags & Locomotion_CrouchIntent) == 0;
+		const bool bStandUpBlocked = bReleasingCrouch && BatchedCharacters[Handle]->IsStandUpBlocked();
+		Flags = bStandUpBlocked ? (Flags | Locomotion_StandUpBlocked) : (Flags & ~Locomotion_StandUpBlocked);
+	}
+
+	// Evaluate the pure math for everyone at once, straight on the slots
+	ParallelFor(DueHandles.Num(), [this](const int32 DueIndex)
+	{
+		const int32 Handle = DueHandles[DueIndex];
+		const uint8 Flags = LocomotionFlags[Handle];
+
+		const FFirstPersonLocomotionState OldState = GetBatchedLocomotion(Handle);
+		FFirstPersonLocomotionState State = OldState;
+		AFPCharacter::StepLocomotion(State, (Flags & Locomotion_CrouchIntent) != 0, (Flags & Locomotion_RunIntent) != 0,
+			(Flags & Locomotion_StandUpBlocked) != 0, LocomotionParams[Handle], PendingDeltaTimes[Handle]);
+		SetBatchedLocomotion(Handle, State);
+
+		const bool bChanged = State.CrouchPhase != OldState.CrouchPhase || State.CrouchPhase == ECrouchPhase::InTransition
+			|| State.MaxWalkSpeed != OldState.MaxWalkSpeed || State.CurrentWalkSpeed != OldState.CurrentWalkSpeed;
+		LocomotionFlags[Handle] = bChanged ? (Flags | Locomotion_Changed) : (Flags & ~Locomotion_Changed);
+		PendingDeltaTimes[Handle] = 0.0f;
+	}, DueHandles.Num() < MinParallelLocomotionBatch);
+
+	// Only characters whose state changed get their capsule, walk speed and camera touched
+	for (const int32 Handle : DueHandles)
+	{
+		AFPCharacter* Character = BatchedCharacters[Handle];
+		Character->UpdateCameraShake();
+
+		if (LocomotionFlags[Handle] & Locomotion_Changed)
+			Character->ApplyLocomotion(GetBatchedLocomotion(Handle));
+
+		if (Character->TryRestLocomotion())
+			LocomotionFlags[Handle] &= ~Locomotion_Awake;
+	}
+}
+
+void UFirstPersonCharacterSubsystem::UpdateSignificance(const float DeltaTime)
+{
+	TimeUntilSignificanceUpdate -= DeltaTime;
+	if (TimeUntilSignificanceUpdate > 0.0f)
+		return;
+
+	// Significance doesn't change quickly, a few updates per second are plenty
+	const float SignificanceUpdateInterval = 0.25f;
+	TimeUntilSignificanceUpdate = SignificanceUpdateInterval;
+
+	ViewLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->IsLocalController())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			ViewLocations.Add(ViewLocation);
+		}
+	}
+
+	for (AFPCharacter* Character : SignificanceCharacters)
+	{
+		// Without local players (e.g. on a dedicated server) there's nothing to save on, and the server's crouch capsule of a remote player
+		// is authoritative, stepping it at a lower rate would cause corrections unless the moves step it
+		const bool bRemoteAuthority = Character->HasAuthority() && Character->IsPlayerControlled() && !Character->IsLocomotionPredicted();
+		if (Character->IsLocallyControlled() || ViewLocations.Num() == 0 || bRemoteAuthority)
+		{
+			Character->SetSignificance(EFirstPersonSignificance::High);
+			continue;
+		}
+
+		float ClosestDistanceSquared = MAX_flt;
+		for (const FVector& ViewLocation : ViewLocations)
+			ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, FVector::DistSquared(ViewLocation, Character->GetActorLocation()));
+
+		const FFirstPersonSignificanceSettings& Settings = Character->Significance;
+		const bool bVisible = Character->WasRecentlyRendered(SignificanceUpdateInterval);
+
+		if (bVisible && ClosestDistanceSquared < FMath::Square(Settings.HighSignificanceDistance))
+			Character->SetSignificance(EFirstPersonSignificance::High);
+		else if (ClosestDistanceSquared < FMath::Square(Settings.MediumSignificanceDistance))
+			Character->SetSignificance(EFirstPersonSignificance::Medium);
+		else
+			Character->SetSignificance(EFirstPersonSignificance::Low);
+	}
+}
+
+void UFirstPersonCharacterSubsystem::ResizeHeadBobArrays(const int32 NewNum)
+{
+	// Pad to whole vector registers. Never shrink the allocations, so steady state never allocates
+	const int32 PaddedNum = Align(NewNum, 4);
+
+	for (TSimdArray<float>* Array : { &BobPhases, &BreathingPhases, &BobWeights, &TargetBobWeights, &BlendAlphas,
+		&VerticalAmplitudes, &LateralAmplitudes, &BreathingAmplitudes, &VerticalOffsets, &LateralOffsets })
+	{
+		const int32 OldNum = Array->Num();
+		Array->SetNum(PaddedNum, false);
+
+		for (int32 i = OldNum; i < PaddedNum; i++)
+			(*Array)[i] = 0.0f;
+	}
+}
+
+void UFirstPersonCharacterSubsystem::GatherHeadBob(const float DeltaTime)
+{
+	for (int32 i = 0; i < HeadBobCharacters.Num(); i++)
+	{
+		const AFPCharacter* Character = HeadBobCharacters[i];
+		const FHeadBobSettings& Settings = Character->HeadBob;
+		const UCharacterMovementComponent* CharacterMovement = Character->GetCharacterMovement();
+
+		// The phase follows the distance travelled on the ground, so the bob stays in sync with the footsteps
+		const float GroundSpeed = CharacterMovement->IsMovingOnGround() ? CharacterMovement->Velocity.Size2D() : 0.0f;
+		BobPhases[i] = FMath::Fmod(BobPhases[i] + 2.0f * PI * GroundSpeed * DeltaTime / Settings.CycleDistance, 2.0f * PI);
+		BreathingPhases[i] = FMath::Fmod(BreathingPhases[i] + 2.0f * PI * Settings.BreathingRate * DeltaTime, 2.0f * PI);
+
+		// Walking is weight 1, running scales the bob up with the speed
+		const float MaxWeight = Character->Movement.RunSpeed / Character->Movement.WalkSpeed;
+		TargetBobWeights[i] = FMath::Clamp(GroundSpeed / Character->Movement.WalkSpeed, 0.0f, MaxWeight);
+		BlendAlphas[i] = FMath::Min(Settings.BlendSpeed * DeltaTime, 1.0f);
+
+		VerticalAmplitudes[i] = Settings.VerticalAmplitude;
+		LateralAmplitudes[i] = Settings.LateralAmplitude;
+		BreathingAmplitudes[i] = Settings.BreathingAmplitude;
+	}
+}
+
+void UFirstPersonCharacterSubsystem::EvaluateHeadBob()
+{
+	const VectorRegister Two = VectorSetFloat1(2.0f);
+
+	for (int32 i = 0; i < BobPhases.Num(); i += 4)
+	{
+		// Blend the bob weight towards its target
+		const VectorRegister TargetWeight = VectorLoadAligned(&TargetBobWeights[i]);
+		VectorRegister Weight = VectorLoadAligned(&BobWeights[i]);
+		Weight = VectorMultiplyAdd(VectorSubtract(TargetWeight, Weight), VectorLoadAligned(&BlendAlphas[i]), Weight);
+		VectorStoreAligned(Weight, &BobWeights[i]);
+
+		// One sin/cos gives us the lateral sway and, through sin(2x) = 2sin(x)cos(x), the vertical bob at twice the frequency
+		const VectorRegister Phase = VectorLoadAligned(&BobPhases[i]);
+		VectorRegister Sin, Cos;
+		VectorSinCos(&Sin, &Cos, &Phase);
+		const VectorRegister Sin2 = VectorMultiply(Two, VectorMultiply(Sin, Cos));
+
+		// Breathing fades out as the bob fades in
+		const VectorRegister BreathingWeight = VectorMax(VectorSubtract(VectorOne(), Weight), VectorZero());
+		const VectorRegister Breathing = VectorMultiply(VectorSin(VectorLoadAligned(&BreathingPhases[i])), VectorMultiply(BreathingWeight, VectorLoadAligned(&BreathingAmplitudes[i])));
+
+		const VectorRegister Vertical = VectorMultiplyAdd(VectorMultiply(VectorLoadAligned(&VerticalAmplitudes[i]), Weight), Sin2, Breathing);
+		const VectorRegister Lateral = VectorMultiply(VectorMultiply(VectorLoadAligned(&LateralAmplitudes[i]), Weight), Sin);
+
+		VectorStoreAligned(Vertical, &VerticalOffsets[i]);
+		VectorStoreAligned(Lateral, &LateralOffsets[i]);
+	}
+}
+
+void UFirstPersonCharacterSubsystem::ApplyHeadBob()
+{
+	for (int32 i = 0; i < HeadBobCharacters.Num(); i++)
+	{
+		AFPCharacter* Character = HeadBobCharacters[i];
+
+		// Only the viewing client sees the camera
+		if (Character->IsLocallyControlled())
+		{
+			Character->HeadBobOffset = FVector(0.0f, LateralOffsets[i], VerticalOffsets[i]);
+			Character->ApplyCameraLocation();
+		}
+	}
+}
@@ -0,0 +1,134 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonCharacterTrace.h"
+
+#if FIRSTPERSONCHARACTER_TRACE_ENABLED
+
+#include "HAL/PlatformTime.h"
+
+#include "Trace/Trace.inl"
+
+UE_TRACE_CHANNEL(FirstPersonCharacterChannel)
+
+UE_TRACE_EVENT_BEGIN(FirstPersonCharacter, CrouchPhase)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, CharacterId)
+	UE_TRACE_EVENT_FIELD(uint8, CrouchPhase)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(FirstPersonCharacter, WalkSpeed)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, CharacterId)
+	UE_TRACE_EVENT_FIELD(float, MaxWalkSpeed)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(FirstPersonCharacter, Stride)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, CharacterId)
+	UE_TRACE_EVENT_FIELD(float, Stride)
+	UE_TRACE_EVENT_FIELD(float, TimeSinceStep)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(FirstPersonCharacter, Footstep)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, CharacterId)
+	UE_TRACE_EVENT_FIELD(bool, bBakedSurface)
+	UE_TRACE_EVENT_FIELD(Trace::WideString, Surface)
+	UE_TRACE_EVENT_FIELD(Trace::WideString, Sound)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(FirstPersonCharacter, ClearanceSweep)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, CharacterId)
+	UE_TRACE_EVENT_FIELD(bool, bBlocked)
+	UE_TRACE_EVENT_FIELD(bool, bAsync)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(FirstPersonCharacter, ShakeTransition)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, CharacterId)
+	UE_TRACE_EVENT_FIELD(uint8, LocomotionState)
+UE_TRACE_EVENT_END()
+
+bool FFirstPersonCharacterTrace::IsEnabled()
+{
+	return UE_TRACE_CHANNELEXPR_IS_ENABLED(FirstPersonCharacterChannel);
+}
+
+// UE_TRACE_LOG names the event it writes after the event type, so the parameters must not.
+// Every event checks the channel first, so nothing is timestamped or gathered while it's off
+void FFirstPersonCharacterTrace::OutputCrouchPhase(const uint32 CharacterId, const uint8 NewCrouchPhase)
+{
+	if (!IsEnabled())
+		return;
+
+	UE_TRACE_LOG(FirstPersonCharacter, CrouchPhase, FirstPersonCharacterChannel)
+		<< CrouchPhase.Cycle(FPlatformTime::Cycles64())
+		<< CrouchPhase.CharacterId(CharacterId)
+		<< CrouchPhase.CrouchPhase(NewCrouchPhase);
+}
+
+void FFirstPersonCharacterTrace::OutputWalkSpeed(const uint32 CharacterId, const float MaxWalkSpeed)
+{
+	if (!IsEnabled())
+		return;
+
+	UE_TRACE_LOG(FirstPersonCharacter, WalkSpeed, FirstPersonCharacterChannel)
+		<< WalkSpeed.Cycle(FPlatformTime::Cycles64())
+		<< WalkSpeed.CharacterId(CharacterId)
+		<< WalkSpeed.MaxWalkSpeed(MaxWalkSpeed);
+}
+
+void FFirstPersonCharacterTrace::OutputStride(const uint32 CharacterId, const float StrideLength, const float TimeSinceStep)
+{
+	if (!IsEnabled())
+		return;
+
+	UE_TRACE_LOG(FirstPersonCharacter, Stride, FirstPersonCharacterChannel)
+		<< Stride.Cycle(FPlatformTime::Cycles64())
+		<< Stride.CharacterId(CharacterId)
+		<< Stride.Stride(StrideLength)
+		<< Stride.TimeSinceStep(TimeSinceStep);
+}
+
+void FFirstPersonCharacterTrace::OutputFootstep(const uint32 CharacterId, const UObject* Surface, const UObject* Sound, const bool bBakedSurface)
+{
+	// The names are only looked up when someone is listening
+	if (!IsEnabled())
+		return;
+
+	const FString SurfaceName = Surface ? Surface->GetName() : FString();
+	const FString SoundName = Sound ? Sound->GetName() : FString();
+
+	UE_TRACE_LOG(FirstPersonCharacter, Footstep, FirstPersonCharacterChannel)
+		<< Footstep.Cycle(FPlatformTime::Cycles64())
+		<< Footstep.CharacterId(CharacterId)
+		<< Footstep.bBakedSurface(bBakedSurface)
+		<< Footstep.Surface(*SurfaceName, SurfaceName.Len())
+		<< Footstep.Sound(*SoundName, SoundName.Len());
+}
+
+void FFirstPersonCharacterTrace::OutputClearanceSweep(const uint32 CharacterId, const bool bBlocked, const bool bAsync)
+{
+	if (!IsEnabled())
+		return;
+
+	UE_TRACE_LOG(FirstPersonCharacter, ClearanceSweep, FirstPersonCharacterChannel)
+		<< ClearanceSweep.Cycle(FPlatformTime::Cycles64())
+		<< ClearanceSweep.CharacterId(CharacterId)
+		<< ClearanceSweep.bBlocked(bBlocked)
+		<< ClearanceSweep.bAsync(bAsync);
+}
+
+void FFirstPersonCharacterTrace::OutputShakeTransition(const uint32 CharacterId, const uint8 LocomotionState)
+{
+	if (!IsEnabled())
+		return;
+
+	UE_TRACE_LOG(FirstPersonCharacter, ShakeTransition, FirstPersonCharacterChannel)
+		<< ShakeTransition.Cycle(FPlatformTime::Cycles64())
+		<< ShakeTransition.CharacterId(CharacterId)
+		<< ShakeTransition.LocomotionState(LocomotionState);
+}
+
+#endif
@@ -0,0 +1,110 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonClearanceSubsystem.h"
+#include "FirstPersonCharacterStats.h"
+#include "FirstPersonCharacterTrace.h"
+
+#include "Components/PrimitiveComponent.h"
+
+#include "Engine/World.h"
+
+DEFINE_STAT(STAT_FirstPersonClearanceSweeps);
+
+namespace
+{
+	// Async sweeps complete on the next frame. One still pending after this many frames was dropped, e.g. by a world that stopped ticking for a moment
+	const uint64 MaxPendingFrames = 8;
+
+	// Requesters that haven't asked for this long are dropped, in case they never called Forget
+	const uint64 MaxIdleFrames = 600;
+}
+
+bool UFirstPersonClearanceSubsystem::IsBlocked(const AActor* Requester, const FVector& Start, const FVector& End, const float Radius, const ECollisionChannel TraceChannel,
+	const FCollisionQueryParams& QueryParams, const FCollisionResponseParams& ResponseParams)
+{
+	if (GFrameCounter - LastPruneFrame > MaxIdleFrames)
+		PruneEntries();
+
+	const uint32 RequesterId = Requester->GetUniqueID();
+	FClearanceEntry& Entry = Entries.FindOrAdd(RequesterId);
+
+	// Without this a dropped result would leave the requester blocked forever
+	if (Entry.bPending && GFrameCounter - Entry.RequestFrame > MaxPendingFrames)
+		Entry.bPending = false;
+
+	if (!Entry.bPending)
+	{
+		if (!SweepDelegate.IsBound())
+			SweepDelegate.BindUObject(this, &UFirstPersonClearanceSubsystem::OnSweepCompleted);
+
+		GetWorld()->AsyncSweepByChannel(EAsyncTraceType::Single, Start, End, FQuat::Identity, TraceChannel,
+			FCollisionShape::MakeSphere(Radius), QueryParams, ResponseParams, &SweepDelegate, RequesterId);
+
+		Entry.RequestFrame = GFrameCounter;
+		Entry.bPending = true;
+		NumSweepsIssued++;
+		INC_DWORD_STAT(STAT_FirstPersonClearanceSweeps);
+	}
+
+	// A result for a sweep from a few frames ago still describes roughly where the requester is now, an older one doesn't
+	const uint64 MaxResultAge = 2;
+	const bool bHasRecentResult = Entry.bHasResult && GFrameCounter - Entry.ResultRequestFrame <= MaxResultAge;
+	if (!bHasRecentResult)
+		return true;
+
+	NumServedFromCache++;
+	return Entry.bBlocked;
+}
+
+bool UFirstPersonClearanceSubsystem::IsBlockedNow(const AActor* Requester, const FVector& Start, const FVector& End, const float Radius, const ECollisionChannel TraceChannel,
+	const FCollisionQueryParams& QueryParams, const FCollisionResponseParams& ResponseParams)
+{
+	NumSweepsIssued++;
+	INC_DWORD_STAT(STAT_FirstPersonClearanceSweeps);
+
+	FHitResult HitResult;
+	GetWorld()->SweepSingleByChannel(HitResult, Start, End, FQuat::Identity, TraceChannel, FCollisionShape::MakeSphere(Radius), QueryParams, ResponseParams);
+
+	// Return true only if the hit actor doesn't simulate physics
+	const bool bBlocked = IsBlockingHit(HitResult);
+	TRACE_FIRSTPERSON_CLEARANCE_SWEEP(Requester->GetUniqueID(), bBlocked, false);
+
+	return bBlocked;
+}
+
+void UFirstPersonClearanceSubsystem::Forget(const AActor* Requester)
+{
+	Entries.Remove(Requester->GetUniqueID());
+}
+
+void UFirstPersonClearanceSubsystem::PruneEntries()
+{
+	LastPruneFrame = GFrameCounter;
+
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (GFrameCounter - It.Value().RequestFrame > MaxIdleFrames)
+			It.RemoveCurrent();
+	}
+}
+
+bool UFirstPersonClearanceSubsystem::IsBlockingHit(const FHitResult& Hit)
+{
+	const UPrimitiveComponent* HitComponent = Hit.GetComponent();
+	return Hit.bBlockingHit && !(HitComponent && HitComponent->IsSimulatingPhysics());
+}
+
+void UFirstPersonClearanceSubsystem::OnSweepCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	// The requester may have been forgotten while the sweep was in flight
+	FClearanceEntry* Entry = Entries.Find(TraceDatum.UserData);
+	if (!Entry)
+		return;
+
+	Entry->bBlocked = TraceDatum.OutHits.Num() > 0 && IsBlockingHit(TraceDatum.OutHits[0]);
+	Entry->bHasResult = true;
+	Entry->bPending = false;
+	Entry->ResultRequestFrame = Entry->RequestFrame;
+
+	TRACE_FIRSTPERSON_CLEARANCE_SWEEP(TraceDatum.UserData, Entry->bBlocked, true);
+}
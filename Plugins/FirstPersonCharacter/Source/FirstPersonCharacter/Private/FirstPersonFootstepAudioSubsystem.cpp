@@ -0,0 +1,296 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonFootstepAudioSubsystem.h"
+#include "FirstPersonCharacter.h"
+#include "FirstPersonCharacterStats.h"
+#include "FirstPersonFootstepData.h"
+
+#include "Components/AudioComponent.h"
+
+#include "Engine/AssetManager.h"
+#include "Engine/World.h"
+
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+#include "HAL/IConsoleManager.h"
+
+#include "Sound/SoundBase.h"
+
+DECLARE_CYCLE_STAT(TEXT("Footstep Audio"), STAT_FootstepAudio, STATGROUP_FirstPersonCharacter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Footsteps Played"), STAT_FootstepsPlayed, STATGROUP_FirstPersonCharacter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Footsteps Culled"), STAT_FootstepsCulled, STATGROUP_FirstPersonCharacter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Footsteps Merged"), STAT_FootstepsMerged, STATGROUP_FirstPersonCharacter);
+
+static TAutoConsoleVariable<int32> CVarFootstepMaxVoices(
+	TEXT("fp.Footsteps.MaxVoices"),
+	16,
+	TEXT("How many footsteps of all characters may play at the same time"));
+
+static TAutoConsoleVariable<float> CVarFootstepMinAudibleVolume(
+	TEXT("fp.Footsteps.MinAudibleVolume"),
+	0.05f,
+	TEXT("Footsteps quieter than this at the listener, after distance attenuation, are culled"));
+
+static TAutoConsoleVariable<float> CVarFootstepMergeDistance(
+	TEXT("fp.Footsteps.MergeDistance"),
+	1500.0f,
+	TEXT("Footsteps further than this from the listener are merged with louder ones close to them"));
+
+static TAutoConsoleVariable<float> CVarFootstepMergeAngle(
+	TEXT("fp.Footsteps.MergeAngle"),
+	0.1f,
+	TEXT("How close two far footsteps have to be to merge, relative to their distance to the listener"));
+
+void UFirstPersonFootstepAudioSubsystem::PlayFootstep(const APawn* Instigator, USoundBase* Sound, const FVector& Location, const float VolumeMultiplier)
+{
+	FFootstepRequest& Request = Requests.AddDefaulted_GetRef();
+	Request.Sound = Sound;
+	Request.Location = Location;
+	Request.VolumeMultiplier = VolumeMultiplier;
+	Request.bLocal = Instigator && Instigator->IsLocallyControlled();
+}
+
+void UFirstPersonFootstepAudioSubsystem::LoadFootstepSounds(const UFirstPersonFootstepData* Mapping)
+{
+	const FSoftObjectPath MappingPath(Mapping);
+	if (!Mapping || FootstepSoundHandles.Contains(MappingPath))
+		return;
+
+	// Mappings scanned by the asset manager know their sound bundle
+	UAssetManager* AssetManager = UAssetManager::GetIfValid();
+	const FPrimaryAssetId MappingId = Mapping->GetPrimaryAssetId();
+	if (AssetManager && AssetManager->GetPrimaryAssetPath(MappingId).IsValid())
+		FootstepSoundHandles.Add(MappingPath, AssetManager->LoadPrimaryAsset(MappingId, { UFirstPersonFootstepData::SoundBundle }));
+	else
+		LoadFootstepSounds(MappingPath, Mapping->GetFootstepSounds());
+}
+
+void UFirstPersonFootstepAudioSubsystem::LoadFootstepSounds(const FSoftObjectPath& Source, const TArrayView<const TSoftObjectPtr<USoundBase>> Sounds)
+{
+	if (FootstepSoundHandles.Contains(Source))
+		return;
+
+	TArray<FSoftObjectPath> SoundPaths;
+	for (const TSoftObjectPtr<USoundBase>& Sound : Sounds)
+	{
+		if (Sound.IsPending())
+			SoundPaths.Add(Sound.ToSoftObjectPath());
+	}
+
+	TSharedPtr<FStreamableHandle> Handle;
+	if (SoundPaths.Num() > 0)
+		Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(SoundPaths);
+
+	// Also remembers sources that didn't need loading, so we don't look at them again
+	FootstepSoundHandles.Add(Source, Handle);
+}
+
+bool UFirstPersonFootstepAudioSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// Dedicated servers have no listeners
+#if FIRSTPERSONCHARACTER_WITH_COSMETICS
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+#else
+	return false;
+#endif
+}
+
+void UFirstPersonFootstepAudioSubsystem::Deinitialize()
+{
+	for (UAudioComponent* Voice : Voices)
+	{
+		if (Voice)
+			Voice->DestroyComponent();
+	}
+
+	Voices.Reset();
+	Requests.Reset();
+
+	// The sounds unload with the next garbage collection unless another world still uses them
+	for (const TPair<FSoftObjectPath, TSharedPtr<FStreamableHandle>>& Handle : FootstepSoundHandles)
+	{
+		if (Handle.Value.IsValid())
+			Handle.Value->ReleaseHandle();
+	}
+
+	FootstepSoundHandles.Reset();
+
+	Super::Deinitialize();
+}
+
+void UFirstPersonFootstepAudioSubsystem::Tick(const float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FootstepAudio);
+	CSV_SCOPED_TIMING_STAT(FirstPersonCharacter, FootstepAudio);
+
+	GatherListeners();
+
+	// Nobody to hear them, e.g. on a server
+	if (ListenerLocations.Num() == 0)
+	{
+		NumCulled += Requests.Num();
+		INC_DWORD_STAT_BY(STAT_FootstepsCulled, Requests.Num());
+		Requests.Reset();
+		return;
+	}
+
+	// Cull what can't be heard before sorting by priority
+	int32 NumCulledThisFrame = Requests.RemoveAllSwap([this](FFootstepRequest& Request) { return !ScoreRequest(Request); }, false);
+
+	Requests.Sort([](const FFootstepRequest& A, const FFootstepRequest& B) { return A.Priority > B.Priority; });
+
+	const int32 MaxVoices = FMath::Max(CVarFootstepMaxVoices.GetValueOnGameThread(), 1);
+	const float MergeDistance = CVarFootstepMergeDistance.GetValueOnGameThread();
+	const float MergeAngle = CVarFootstepMergeAngle.GetValueOnGameThread();
+
+	int32 NumMergedThisFrame = 0;
+	AcceptedRequests.Reset();
+	for (FFootstepRequest& Request : Requests)
+	{
+		// Far footsteps next to a louder one blend into it, the listener can't tell them apart
+		FFootstepRequest* MergeTarget = nullptr;
+		if (!Request.bLocal && Request.ListenerDistance > MergeDistance)
+		{
+			const float MergeRadius = Request.ListenerDistance * MergeAngle;
+			for (FFootstepRequest* Accepted : AcceptedRequests)
+			{
+				if (!Accepted->bLocal && FVector::DistSquared(Accepted->Location, Request.Location) < FMath::Square(MergeRadius))
+				{
+					MergeTarget = Accepted;
+					break;
+				}
+			}
+		}
+
+		if (MergeTarget)
+		{
+			// A little louder, as two steps would be
+			MergeTarget->VolumeMultiplier = FMath::Min(MergeTarget->VolumeMultiplier + Request.VolumeMultiplier * 0.25f, 1.0f);
+			NumMergedThisFrame++;
+			continue;
+		}
+
+		AcceptedRequests.Add(&Request);
+	}
+
+	// Highest priority first, until we run out of voices
+	int32 NumPlayedThisFrame = 0;
+	for (const FFootstepRequest* Request : AcceptedRequests)
+	{
+		UAudioComponent* Voice = GetFreeVoice(MaxVoices);
+		if (!Voice)
+		{
+			NumCulledThisFrame++;
+			continue;
+		}
+
+		Voice->SetWorldLocation(Request->Location);
+		Voice->SetSound(Request->Sound);
+		Voice->SetVolumeMultiplier(Request->VolumeMultiplier);
+		Voice->Play();
+		NumPlayedThisFrame++;
+	}
+
+	Requests.Reset();
+
+	NumPlayed += NumPlayedThisFrame;
+	NumCulled += NumCulledThisFrame;
+	NumMerged += NumMergedThisFrame;
+	INC_DWORD_STAT_BY(STAT_FootstepsPlayed, NumPlayedThisFrame);
+	INC_DWORD_STAT_BY(STAT_FootstepsCulled, NumCulledThisFrame);
+	INC_DWORD_STAT_BY(STAT_FootstepsMerged, NumMergedThisFrame);
+	CSV_CUSTOM_STAT(FirstPersonCharacter, FootstepsPlayed, NumPlayedThisFrame, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FirstPersonCharacter, FootstepsCulled, NumCulledThisFrame, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FirstPersonCharacter, FootstepsMerged, NumMergedThisFrame, ECsvCustomStatOp::Set);
+}
+
+ETickableTickType UFirstPersonFootstepAudioSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFirstPersonFootstepAudioSubsystem::IsTickable() const
+{
+	return Requests.Num() > 0;
+}
+
+TStatId UFirstPersonFootstepAudioSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFirstPersonFootstepAudioSubsystem, STATGROUP_Tickables);
+}
+
+void UFirstPersonFootstepAudioSubsystem::GatherListeners()
+{
+	ListenerLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->IsLocalController())
+		{
+			FVector ListenerLocation, FrontDirection, RightDirection;
+			PlayerController->GetAudioListenerPosition(ListenerLocation, FrontDirection, RightDirection);
+			ListenerLocations.Add(ListenerLocation);
+		}
+	}
+}
+
+bool UFirstPersonFootstepAudioSubsystem::ScoreRequest(FFootstepRequest& Request) const
+{
+	if (!Request.Sound)
+		return false;
+
+	float ClosestDistanceSquared = MAX_flt;
+	for (const FVector& ListenerLocation : ListenerLocations)
+		ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, FVector::DistSquared(ListenerLocation, Request.Location));
+
+	Request.ListenerDistance = FMath::Sqrt(ClosestDistanceSquared);
+
+	// Our own footsteps go first
+	if (Request.bLocal)
+	{
+		Request.Priority = MAX_flt;
+		return true;
+	}
+
+	// A linear falloff is a good enough estimate of what the attenuation leaves of it
+	const float MaxDistance = Request.Sound->GetMaxDistance();
+	if (Request.ListenerDistance >= MaxDistance)
+		return false;
+
+	const float Falloff = MaxDistance < WORLD_MAX ? 1.0f - Request.ListenerDistance / MaxDistance : 1.0f;
+	Request.Priority = Request.VolumeMultiplier * Falloff;
+
+	return Request.Priority >= CVarFootstepMinAudibleVolume.GetValueOnGameThread();
+}
+
+UAudioComponent* UFirstPersonFootstepAudioSubsystem::GetFreeVoice(const int32 MaxVoices)
+{
+	int32 NumValidVoices = 0;
+	for (UAudioComponent* Voice : Voices)
+	{
+		if (!IsValid(Voice))
+			continue;
+
+		if (!Voice->IsPlaying())
+			return Voice;
+
+		NumValidVoices++;
+	}
+
+	if (NumValidVoices >= MaxVoices)
+		return nullptr;
+
+	// Grow the pool, the component is played by the caller
+	Voices.RemoveAll([](const UAudioComponent* Voice) { return !IsValid(Voice); });
+
+	// Like the components of UGameplayStatics::SpawnSoundAtLocation, without an owner, but kept around
+	UAudioComponent* Voice = NewObject<UAudioComponent>(GetWorld());
+	Voice->bAutoActivate = false;
+	Voice->bAutoDestroy = false;
+	Voice->bAllowSpatialization = true;
+	Voice->RegisterComponentWithWorld(GetWorld());
+
+	Voices.Add(Voice);
+	return Voice;
+}
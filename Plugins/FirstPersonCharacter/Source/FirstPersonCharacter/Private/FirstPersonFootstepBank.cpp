@@ -0,0 +1,71 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonFootstepBank.h"
+#include "FirstPersonCharacter.h"
+#include "FirstPersonFootstepData.h"
+
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+#if WITH_EDITOR
+int32 UFirstPersonFootstepBank::Cook(const TArray<UFirstPersonFootstepData*>& Mappings)
+{
+	Entries.Reset();
+	Sounds.Reset();
+	SurfaceTypeToEntry.Init(INDEX_NONE, SurfaceType_Max);
+
+	int32 NumErrors = 0;
+	for (const UFirstPersonFootstepData* Mapping : Mappings)
+	{
+		if (!Mapping)
+			continue;
+
+		UPhysicalMaterial* PhysicalMaterial = Mapping->GetPhysicalMaterial();
+		if (!PhysicalMaterial)
+		{
+			UE_LOG(LogFirstPersonCharacter, Error, TEXT("%s has no physical material"), *Mapping->GetPathName())
+			NumErrors++;
+			continue;
+		}
+
+		// The first mapping of a physical material wins, same as at runtime
+		const FFirstPersonFootstepBankEntry* Duplicate = Entries.FindByPredicate([PhysicalMaterial](const FFirstPersonFootstepBankEntry& Entry) { return Entry.PhysicalMaterial == PhysicalMaterial; });
+		if (Duplicate)
+		{
+			UE_LOG(LogFirstPersonCharacter, Error, TEXT("%s uses %s, which is already mapped by %s"), *Mapping->GetPathName(), *PhysicalMaterial->GetName(), *Duplicate->Source.ToString())
+			NumErrors++;
+			continue;
+		}
+
+		const int32 FirstSound = Sounds.Num();
+		for (const TSoftObjectPtr<USoundBase>& Sound : Mapping->GetFootstepSounds())
+		{
+			if (!Sound.IsNull())
+				Sounds.Add(Sound);
+		}
+
+		if (Sounds.Num() == FirstSound)
+		{
+			UE_LOG(LogFirstPersonCharacter, Error, TEXT("%s has no sounds"), *Mapping->GetPathName())
+			NumErrors++;
+			continue;
+		}
+
+		FFirstPersonFootstepBankEntry& Entry = Entries.AddDefaulted_GetRef();
+		Entry.PhysicalMaterial = PhysicalMaterial;
+		Entry.Source = FSoftObjectPath(Mapping);
+		Entry.WalkStride = FMath::Max(Mapping->GetFootstepStride_Walk(), 1.0f);
+		Entry.RunStride = FMath::Max(Mapping->GetFootstepStride_Run(), 1.0f);
+		Entry.CrouchStride = FMath::Max(Mapping->GetFootstepStride_Crouch(), 1.0f);
+		Entry.FirstSound = FirstSound;
+		Entry.NumSounds = Sounds.Num() - FirstSound;
+
+		const int32 SurfaceType = PhysicalMaterial->SurfaceType;
+		if (SurfaceType != SurfaceType_Default && SurfaceTypeToEntry[SurfaceType] == INDEX_NONE)
+			SurfaceTypeToEntry[SurfaceType] = Entries.Num() - 1;
+	}
+
+	MarkPackageDirty();
+
+	return NumErrors;
+}
+#endif
@@ -0,0 +1,83 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonFootstepBankCommandlet.h"
+#include "FirstPersonCharacter.h"
+#include "FirstPersonFootstepBank.h"
+#include "FirstPersonFootstepData.h"
+
+#include "AssetRegistryModule.h"
+
+#include "Misc/PackageName.h"
+
+#include "UObject/Package.h"
+
+UFirstPersonFootstepBankCommandlet::UFirstPersonFootstepBankCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UFirstPersonFootstepBankCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString BankName;
+	if (!FParse::Value(*Params, TEXT("Bank="), BankName, false) || !FPackageName::IsValidLongPackageName(BankName))
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("Usage: -run=FirstPersonFootstepBank -Bank=/Game/Footsteps/FootstepBank [-Paths=/Game/Footsteps+/Game/Other]"))
+		return 1;
+	}
+
+	FString PathList = TEXT("/Game");
+	FParse::Value(*Params, TEXT("Paths="), PathList, false);
+
+	TArray<FString> Paths;
+	PathList.ParseIntoArray(Paths, TEXT("+"));
+
+	// Commandlets don't wait for the asset registry to finish its initial scan
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+	AssetRegistry.ScanPathsSynchronous(Paths);
+
+	FARFilter Filter;
+	Filter.ClassNames.Add(UFirstPersonFootstepData::StaticClass()->GetFName());
+	Filter.bRecursiveClasses = true;
+	Filter.bRecursivePaths = true;
+	for (const FString& Path : Paths)
+		Filter.PackagePaths.Add(*Path);
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+
+	// Sorted, so the bank is the same on every machine and duplicates resolve the same way
+	Assets.Sort([](const FAssetData& A, const FAssetData& B) { return A.ObjectPath.LexicalLess(B.ObjectPath); });
+
+	TArray<UFirstPersonFootstepData*> Mappings;
+	for (const FAssetData& Asset : Assets)
+	{
+		if (UFirstPersonFootstepData* Mapping = Cast<UFirstPersonFootstepData>(Asset.GetAsset()))
+			Mappings.Add(Mapping);
+	}
+
+	const FString AssetName = FPackageName::GetShortName(BankName);
+	UPackage* Package = CreatePackage(*BankName);
+	UFirstPersonFootstepBank* Bank = FindObject<UFirstPersonFootstepBank>(Package, *AssetName);
+	if (!Bank)
+		Bank = NewObject<UFirstPersonFootstepBank>(Package, *AssetName, RF_Public | RF_Standalone);
+
+	const int32 NumErrors = Bank->Cook(Mappings);
+
+	UE_LOG(LogFirstPersonCharacter, Display, TEXT("Cooked %d of %d footstep data assets into %s with %d sounds"), Bank->GetEntries().Num(), Mappings.Num(), *BankName, Bank->GetSounds().Num())
+
+	const FString FileName = FPackageName::LongPackageNameToFilename(BankName, FPackageName::GetAssetPackageExtension());
+	if (!UPackage::SavePackage(Package, Bank, RF_Standalone, *FileName))
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("Couldn't save %s"), *FileName)
+		return 1;
+	}
+
+	return NumErrors > 0 ? 1 : 0;
+#else
+	return 1;
+#endif
+}
@@ -2,3 +2,4 @@
 
 #include "FirstPersonFootstepData.h"
 
+const FName UFirstPersonFootstepData::SoundBundle(TEXT("Footsteps"));
@@ -0,0 +1,187 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonFootstepTable.h"
+#include "FirstPersonFootstepBank.h"
+#include "FirstPersonFootstepData.h"
+
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+void FFirstPersonFootstepTable::Build(const TArray<UFirstPersonFootstepData*>& Mappings)
+{
+	Reset();
+
+	SurfaceTypeToEntry.Init(INDEX_NONE, SurfaceType_Max);
+
+	for (UFirstPersonFootstepData* Mapping : Mappings)
+	{
+		if (!Mapping || !Mapping->GetPhysicalMaterial())
+			continue;
+
+		// The first mapping of a physical material wins, same as the old linear search
+		const UPhysicalMaterial* PhysicalMaterial = Mapping->GetPhysicalMaterial();
+		if (MaterialToEntry.Contains(PhysicalMaterial))
+			continue;
+
+		const int32 EntryIndex = Entries.AddDefaulted();
+		FEntry& Entry = Entries[EntryIndex];
+		Entry.Source = FSoftObjectPath(Mapping);
+		Entry.Mapping = Mapping;
+		Entry.Strides[static_cast<int32>(EFootstepStance::Walk)] = Mapping->GetFootstepStride_Walk();
+		Entry.Strides[static_cast<int32>(EFootstepStance::Run)] = Mapping->GetFootstepStride_Run();
+		Entry.Strides[static_cast<int32>(EFootstepStance::Crouch)] = Mapping->GetFootstepStride_Crouch();
+		Entry.FirstSound = Sounds.Num();
+		Entry.NumSounds = 0;
+		Entry.LastSound = INDEX_NONE;
+
+		for (const TSoftObjectPtr<USoundBase>& Sound : Mapping->GetFootstepSounds())
+		{
+			if (!Sound.IsNull())
+			{
+				ShuffleBag.Add(Entry.NumSounds++);
+				Sounds.Add(Sound);
+			}
+		}
+
+		// Start with an empty bag so the first pick shuffles it
+		Entry.BagCursor = Entry.NumSounds;
+
+		MaterialToEntry.Add(PhysicalMaterial, EntryIndex);
+
+		const int32 SurfaceType = PhysicalMaterial->SurfaceType;
+		if (SurfaceType != SurfaceType_Default && SurfaceTypeToEntry[SurfaceType] == INDEX_NONE)
+			SurfaceTypeToEntry[SurfaceType] = EntryIndex;
+	}
+}
+
+void FFirstPersonFootstepTable::Build(const UFirstPersonFootstepBank& Bank)
+{
+	Reset();
+
+	SurfaceTypeToEntry = Bank.GetSurfaceTypeToEntry();
+	Sounds = Bank.GetSounds();
+
+	const TArray<FFirstPersonFootstepBankEntry>& BankEntries = Bank.GetEntries();
+	Entries.Reserve(BankEntries.Num());
+	MaterialToEntry.Reserve(BankEntries.Num());
+	ShuffleBag.Reserve(Sounds.Num());
+
+	for (const FFirstPersonFootstepBankEntry& BankEntry : BankEntries)
+	{
+		const int32 EntryIndex = Entries.AddDefaulted();
+		FEntry& Entry = Entries[EntryIndex];
+		Entry.Source = BankEntry.Source;
+		Entry.Mapping = nullptr;
+		Entry.Strides[static_cast<int32>(EFootstepStance::Walk)] = BankEntry.WalkStride;
+		Entry.Strides[static_cast<int32>(EFootstepStance::Run)] = BankEntry.RunStride;
+		Entry.Strides[static_cast<int32>(EFootstepStance::Crouch)] = BankEntry.CrouchStride;
+		Entry.FirstSound = BankEntry.FirstSound;
+		Entry.NumSounds = BankEntry.NumSounds;
+		Entry.BagCursor = Entry.NumSounds;
+		Entry.LastSound = INDEX_NONE;
+
+		for (int32 i = 0; i < Entry.NumSounds; i++)
+			ShuffleBag.Add(i);
+
+		MaterialToEntry.Add(BankEntry.PhysicalMaterial, EntryIndex);
+	}
+}
+
+void FFirstPersonFootstepTable::Reset()
+{
+	MaterialToEntry.Reset();
+	SurfaceTypeToEntry.Reset();
+	Entries.Reset();
+	Sounds.Reset();
+	ShuffleBag.Reset();
+}
+
+int32 FFirstPersonFootstepTable::FindEntry(const UPhysicalMaterial* Surface) const
+{
+	if (!Surface)
+		return INDEX_NONE;
+
+	if (const int32* EntryIndex = MaterialToEntry.Find(Surface))
+		return *EntryIndex;
+
+	// Different physical materials may share a surface type
+	const int32 SurfaceType = Surface->SurfaceType;
+	return SurfaceTypeToEntry.IsValidIndex(SurfaceType) ? SurfaceTypeToEntry[SurfaceType] : INDEX_NONE;
+}
+
+float FFirstPersonFootstepTable::GetStride(const int32 Entry, const EFootstepStance Stance) const
+{
+	return Entries[Entry].Strides[static_cast<int32>(Stance)];
+}
+
+UFirstPersonFootstepData* FFirstPersonFootstepTable::GetMapping(const int32 Entry) const
+{
+	return Entries[Entry].Mapping;
+}
+
+TArrayView<const TSoftObjectPtr<USoundBase>> FFirstPersonFootstepTable::GetSounds(const int32 Entry) const
+{
+	return MakeArrayView(Sounds.GetData() + Entries[Entry].FirstSound, Entries[Entry].NumSounds);
+}
+
+const FSoftObjectPath& FFirstPersonFootstepTable::GetSource(const int32 Entry) const
+{
+	return Entries[Entry].Source;
+}
+
+USoundBase* FFirstPersonFootstepTable::PickSound(const int32 Entry, FRandomStream& Random)
+{
+	FEntry& TableEntry = Entries[Entry];
+	if (TableEntry.NumSounds == 0)
+		return nullptr;
+
+	// A second bag when nothing that's left of the first one is loaded yet
+	for (int32 Attempt = 0; Attempt < 2; Attempt++)
+	{
+		if (TableEntry.BagCursor >= TableEntry.NumSounds)
+			Shuffle(TableEntry, Random);
+
+		// Sounds that are still loading stay in the bag for later
+		int32* Bag = &ShuffleBag[TableEntry.FirstSound];
+		int32 Pick = INDEX_NONE;
+		for (int32 i = TableEntry.BagCursor; i < TableEntry.NumSounds; i++)
+		{
+			if (!Sounds[TableEntry.FirstSound + Bag[i]].Get())
+				continue;
+
+			// Don't play the same sound twice in a row if there's another one
+			Pick = i;
+			if (Bag[i] != TableEntry.LastSound)
+				break;
+		}
+
+		if (Pick != INDEX_NONE)
+		{
+			Swap(Bag[Pick], Bag[TableEntry.BagCursor]);
+			TableEntry.LastSound = Bag[TableEntry.BagCursor++];
+			return Sounds[TableEntry.FirstSound + TableEntry.LastSound].Get();
+		}
+
+		// Nothing of a whole bag is loaded
+		if (TableEntry.BagCursor == 0)
+			return nullptr;
+
+		TableEntry.BagCursor = TableEntry.NumSounds;
+	}
+
+	return nullptr;
+}
+
+void FFirstPersonFootstepTable::Shuffle(FEntry& Entry, FRandomStream& Random)
+{
+	int32* Bag = &ShuffleBag[Entry.FirstSound];
+
+	// Fisher-Yates
+	for (int32 i = Entry.NumSounds - 1; i > 0; i--)
+		Swap(Bag[i], Bag[Random.RandRange(0, i)]);
+
+	// Don't play the same sound twice in a row across two bags
+	if (Entry.NumSounds > 1 && Bag[0] == Entry.LastSound)
+		Swap(Bag[0], Bag[Random.RandRange(1, Entry.NumSounds - 1)]);
+
+	Entry.BagCursor = 0;
+}
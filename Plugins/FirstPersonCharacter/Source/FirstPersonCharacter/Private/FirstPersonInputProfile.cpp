@@ -0,0 +1,90 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonInputProfile.h"
+
+namespace
+{
+	FFirstPersonInputProfile MakeDefaultProfile()
+	{
+		FFirstPersonInputProfile Profile;
+
+		const auto AddActionMapping = [&Profile](const FName Name, const FKey Key)
+		{
+			FInputActionKeyMapping ActionMapping;
+			ActionMapping.ActionName = Name;
+			ActionMapping.Key = Key;
+			Profile.ActionMappings.Add(ActionMapping);
+		};
+
+		const auto AddAxisMapping = [&Profile](const FName Name, const FKey Key, const float Scale)
+		{
+			FInputAxisKeyMapping AxisMapping;
+			AxisMapping.AxisName = Name;
+			AxisMapping.Key = Key;
+			AxisMapping.Scale = Scale;
+			Profile.AxisMappings.Add(AxisMapping);
+		};
+
+		AddActionMapping(FName("Jump"), EKeys::SpaceBar);
+		AddActionMapping(FName("Interact"), EKeys::F);
+		AddActionMapping(FName("Escape"), EKeys::Escape);
+		AddActionMapping(FName("Run"), EKeys::LeftShift);
+		AddActionMapping(FName("Crouch"), EKeys::LeftControl);
+		AddActionMapping(FName("Crouch"), EKeys::C);
+
+		AddAxisMapping(FName("Turn"), EKeys::MouseX, 1.0f);
+		AddAxisMapping(FName("LookUp"), EKeys::MouseY, -1.0f);
+		AddAxisMapping(FName("MoveForward"), EKeys::W, 1.0f);
+		AddAxisMapping(FName("MoveForward"), EKeys::S, -1.0f);
+		AddAxisMapping(FName("MoveRight"), EKeys::D, 1.0f);
+		AddAxisMapping(FName("MoveRight"), EKeys::A, -1.0f);
+
+		return Profile;
+	}
+}
+
+const FFirstPersonInputProfile& FFirstPersonInputProfile::GetDefault()
+{
+	static const FFirstPersonInputProfile DefaultProfile = MakeDefaultProfile();
+	return DefaultProfile;
+}
+
+void FFirstPersonInputProfile::ApplyTo(UPlayerInput* PlayerInput, const bool bKeepExistingBindings) const
+{
+	TSet<FName> ActionNames;
+	for (const FInputActionKeyMapping& ActionMapping : ActionMappings)
+		ActionNames.Add(ActionMapping.ActionName);
+
+	TSet<FName> AxisNames;
+	for (const FInputAxisKeyMapping& AxisMapping : AxisMappings)
+		AxisNames.Add(AxisMapping.AxisName);
+
+	if (bKeepExistingBindings)
+	{
+		for (const FInputActionKeyMapping& ActionMapping : PlayerInput->ActionMappings)
+			ActionNames.Remove(ActionMapping.ActionName);
+
+		for (const FInputAxisKeyMapping& AxisMapping : PlayerInput->AxisMappings)
+			AxisNames.Remove(AxisMapping.AxisName);
+	}
+	else
+	{
+		PlayerInput->ActionMappings.RemoveAll([&ActionNames](const FInputActionKeyMapping& ActionMapping) { return ActionNames.Contains(ActionMapping.ActionName); });
+		PlayerInput->AxisMappings.RemoveAll([&AxisNames](const FInputAxisKeyMapping& AxisMapping) { return AxisNames.Contains(AxisMapping.AxisName); });
+	}
+
+	for (const FInputActionKeyMapping& ActionMapping : ActionMappings)
+	{
+		if (ActionNames.Contains(ActionMapping.ActionName))
+			PlayerInput->ActionMappings.Add(ActionMapping);
+	}
+
+	for (const FInputAxisKeyMapping& AxisMapping : AxisMappings)
+	{
+		if (AxisNames.Contains(AxisMapping.AxisName))
+			PlayerInput->AxisMappings.Add(AxisMapping);
+	}
+
+	// Only rebuilds this player's key maps, on its next input event
+	PlayerInput->ForceRebuildingKeyMaps(false);
+}
@@ -0,0 +1,353 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonInputRecorderComponent.h"
+#include "FirstPersonCharacter.h"
+#include "FPCharacter.h"
+
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+
+#include "HAL/FileManager.h"
+
+#include "Kismet/KismetSystemLibrary.h"
+
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	const uint32 InputRecordingMagic = 0x52495046; // "FPIR"
+	const uint32 InputRecordingVersion = 2;
+
+	bool IsAxis(const EFirstPersonInputEvent Event)
+	{
+		return Event < EFirstPersonInputEvent::NumAxes;
+	}
+}
+
+UFirstPersonInputRecorderComponent::UFirstPersonInputRecorderComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+}
+
+bool UFirstPersonInputRecorderComponent::StartRecording(const FString& FileName)
+{
+	AFPCharacter* Character = GetCharacter();
+	if (!Character || !Character->Controller)
+		return false;
+
+	Stop();
+
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*FileName));
+	if (!Writer)
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("Couldn't create input recording %s"), *FileName)
+		return false;
+	}
+
+	// Replays start from here, with the same footsteps
+	FHeader Header;
+	Header.Location = Character->GetActorLocation();
+	Header.ActorRotation = Character->GetActorRotation();
+	Header.ControlRotation = Character->Controller->GetControlRotation();
+	Header.FootstepSeed = FMath::Rand();
+	SerializeHeader(*Writer, Header);
+
+	Character->FootstepRandom.Initialize(Header.FootstepSeed);
+
+	FMemory::Memzero(AxisValues);
+	PendingEvents.Reset();
+	NumFrames = 0;
+
+	// This frame's input has been processed by the time we tick
+	PrerequisiteController = Character->Controller;
+	AddTickPrerequisiteActor(Character->Controller);
+	SetComponentTickEnabled(true);
+
+	UE_LOG(LogFirstPersonCharacter, Log, TEXT("Recording the input of %s into %s"), *Character->GetName(), *FileName)
+	return true;
+}
+
+bool UFirstPersonInputRecorderComponent::StartReplay(const FString& FileName)
+{
+	AFPCharacter* Character = GetCharacter();
+	if (!Character)
+		return false;
+
+	Stop();
+
+	Reader.Reset(IFileManager::Get().CreateFileReader(*FileName));
+	if (!Reader)
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("Couldn't open input recording %s"), *FileName)
+		return false;
+	}
+
+	FHeader Header;
+	SerializeHeader(*Reader, Header);
+	if (Reader->IsError())
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("%s isn't an input recording of this version"), *FileName)
+		Reader.Reset();
+		return false;
+	}
+
+	Character->SetActorLocationAndRotation(Header.Location, Header.ActorRotation, false, nullptr, ETeleportType::ResetPhysics);
+	if (Character->Controller)
+		Character->Controller->SetControlRotation(Header.ControlRotation);
+
+	Character->FootstepRandom.Initialize(Header.FootstepSeed);
+
+	// Whoever sits at the keyboard must not add to the recorded input
+	Character->DisableInput(nullptr);
+
+	// Every frame takes the game time it took when it was recorded, however long it takes to simulate
+	bRestoreFixedTimeStep = !FApp::UseFixedTimeStep();
+	PreviousFixedDeltaTime = FApp::GetFixedDeltaTime();
+	FApp::SetUseFixedTimeStep(true);
+
+	FMemory::Memzero(AxisValues);
+	NumFrames = 0;
+
+	if (!ReadFrame())
+	{
+		Stop();
+		return false;
+	}
+
+	// Our input has to be in before the controller applies the look input and the character moves
+	if (Character->Controller)
+	{
+		PrerequisiteController = Character->Controller;
+		Character->Controller->AddTickPrerequisiteComponent(this);
+	}
+	Character->GetCharacterMovement()->AddTickPrerequisiteComponent(this);
+	SetComponentTickEnabled(true);
+
+	UE_LOG(LogFirstPersonCharacter, Log, TEXT("Replaying %s on %s"), *FileName, *Character->GetName())
+	return true;
+}
+
+void UFirstPersonInputRecorderComponent::Stop()
+{
+	AFPCharacter* Character = GetCharacter();
+
+	if (Writer)
+	{
+		WriteFrame();
+		Writer->Close();
+		Writer.Reset();
+
+		if (AController* Controller = PrerequisiteController.Get())
+			RemoveTickPrerequisiteActor(Controller);
+
+		UE_LOG(LogFirstPersonCharacter, Log, TEXT("Recorded %d frames of input"), NumFrames)
+	}
+
+	if (Reader)
+	{
+		Reader->Close();
+		Reader.Reset();
+
+		if (bRestoreFixedTimeStep)
+		{
+			FApp::SetUseFixedTimeStep(false);
+			FApp::SetFixedDeltaTime(PreviousFixedDeltaTime);
+		}
+
+		if (AController* Controller = PrerequisiteController.Get())
+			Controller->RemoveTickPrerequisiteComponent(this);
+
+		if (Character)
+		{
+			Character->GetCharacterMovement()->RemoveTickPrerequisiteComponent(this);
+			Character->EnableInput(nullptr);
+		}
+
+		UE_LOG(LogFirstPersonCharacter, Log, TEXT("Replayed %d frames of input"), NumFrames)
+	}
+
+	PrerequisiteController.Reset();
+	PendingEvents.Reset();
+	SetComponentTickEnabled(false);
+}
+
+void UFirstPersonInputRecorderComponent::Record(const EFirstPersonInputEvent Event, const float Value)
+{
+	if (!Writer)
+		return;
+
+	// Axes are sent every frame, most of the time with the value they had last frame
+	if (IsAxis(Event))
+	{
+		float& AxisValue = AxisValues[(int32)Event];
+		if (AxisValue == Value)
+			return;
+
+		AxisValue = Value;
+	}
+
+	PendingEvents.Emplace(Event, Value);
+}
+
+bool UFirstPersonInputRecorderComponent::StartFromCommandLine()
+{
+	FString FileName;
+	if (FParse::Value(FCommandLine::Get(), TEXT("-FPReplay="), FileName))
+	{
+		bStartedFromCommandLine = true;
+		return StartReplay(FPaths::IsRelative(FileName) ? FPaths::ProjectSavedDir() / FileName : FileName);
+	}
+
+	if (FParse::Value(FCommandLine::Get(), TEXT("-FPRecord="), FileName))
+	{
+		bStartedFromCommandLine = true;
+		return StartRecording(FPaths::IsRelative(FileName) ? FPaths::ProjectSavedDir() / FileName : FileName);
+	}
+
+	return false;
+}
+
+bool UFirstPersonInputRecorderComponent::IsRequestedOnCommandLine()
+{
+	FString FileName;
+	return FParse::Value(FCommandLine::Get(), TEXT("-FPReplay="), FileName) || FParse::Value(FCommandLine::Get(), TEXT("-FPRecord="), FileName);
+}
+
+void UFirstPersonInputRecorderComponent::TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (Writer)
+	{
+		WriteFrame();
+	}
+	else if (Reader)
+	{
+		ReplayFrame();
+		if (ReadFrame())
+			return;
+
+		Stop();
+
+		if (bStartedFromCommandLine && bQuitAfterReplay)
+			UKismetSystemLibrary::QuitGame(this, nullptr, EQuitPreference::Quit, false);
+	}
+}
+
+void UFirstPersonInputRecorderComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Stop();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UFirstPersonInputRecorderComponent::SerializeHeader(FArchive& Ar, FHeader& Header)
+{
+	uint32 Magic = InputRecordingMagic;
+	uint32 Version = InputRecordingVersion;
+	Ar << Magic << Version;
+
+	if (Magic != InputRecordingMagic || Version != InputRecordingVersion)
+	{
+		Ar.SetError();
+		return;
+	}
+
+	Ar << Header.Location << Header.ActorRotation << Header.ControlRotation << Header.FootstepSeed;
+}
+
+void UFirstPersonInputRecorderComponent::WriteFrame()
+{
+	// One frame is its time step and the number of events, followed by the events. Only axes have a value
+	double DeltaTime = FApp::GetDeltaTime();
+	*Writer << DeltaTime;
+
+	uint32 NumEvents = PendingEvents.Num();
+	Writer->SerializeIntPacked(NumEvents);
+
+	for (TPair<EFirstPersonInputEvent, float>& Event : PendingEvents)
+	{
+		*Writer << Event.Key;
+
+		if (IsAxis(Event.Key))
+			*Writer << Event.Value;
+	}
+
+	PendingEvents.Reset();
+	NumFrames++;
+}
+
+bool UFirstPersonInputRecorderComponent::ReadFrame()
+{
+	PendingEvents.Reset();
+	if (Reader->AtEnd())
+		return false;
+
+	double DeltaTime = 0.0;
+	*Reader << DeltaTime;
+
+	uint32 NumEvents = 0;
+	Reader->SerializeIntPacked(NumEvents);
+
+	for (uint32 i = 0; i < NumEvents && !Reader->IsError(); i++)
+	{
+		EFirstPersonInputEvent Event;
+		*Reader << Event;
+
+		float Value = 0.0f;
+		if (IsAxis(Event))
+			*Reader << Value;
+		else if (Event > EFirstPersonInputEvent::CrouchReleased)
+			Reader->SetError();
+
+		PendingEvents.Emplace(Event, Value);
+	}
+
+	if (Reader->IsError() || DeltaTime <= 0.0)
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("The input recording is corrupt after %d frames"), NumFrames)
+		return false;
+	}
+
+	// The engine picks this up when the next frame starts, which is the one we replay this frame in
+	FApp::SetFixedDeltaTime(DeltaTime);
+	return true;
+}
+
+void UFirstPersonInputRecorderComponent::ReplayFrame()
+{
+	AFPCharacter* Character = GetCharacter();
+	if (!Character)
+		return;
+
+	for (const TPair<EFirstPersonInputEvent, float>& Event : PendingEvents)
+	{
+		switch (Event.Key)
+		{
+			case EFirstPersonInputEvent::JumpPressed: Character->Jump(); break;
+			case EFirstPersonInputEvent::JumpReleased: Character->StopJumping(); break;
+			case EFirstPersonInputEvent::RunPressed: Character->Run(); break;
+			case EFirstPersonInputEvent::RunReleased: Character->StopRunning(); break;
+			case EFirstPersonInputEvent::CrouchPressed: Character->StartCrouch(); break;
+			case EFirstPersonInputEvent::CrouchReleased: Character->StopCrouching(); break;
+			default: AxisValues[(int32)Event.Key] = Event.Value; break;
+		}
+	}
+
+	// Axis bindings fire every frame, so do we
+	Character->MoveForward(AxisValues[(int32)EFirstPersonInputEvent::MoveForward]);
+	Character->MoveRight(AxisValues[(int32)EFirstPersonInputEvent::MoveRight]);
+	Character->AddControllerYawInput(AxisValues[(int32)EFirstPersonInputEvent::Turn]);
+	Character->AddControllerPitchInput(AxisValues[(int32)EFirstPersonInputEvent::LookUp]);
+
+	NumFrames++;
+}
+
+AFPCharacter* UFirstPersonInputRecorderComponent::GetCharacter() const
+{
+	return Cast<AFPCharacter>(GetOwner());
+}
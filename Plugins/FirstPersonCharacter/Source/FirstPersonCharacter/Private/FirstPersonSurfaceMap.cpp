@@ -0,0 +1,88 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonSurfaceMap.h"
+#include "FirstPersonCharacter.h"
+
+#include "Components/PrimitiveComponent.h"
+
+#include "Engine/World.h"
+
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+bool UFirstPersonSurfaceMap::Sample(const FVector& Location, const float MaxHeightDifference, const UPhysicalMaterial*& OutSurface) const
+{
+	const int32 X = FMath::FloorToInt((Location.X - Origin.X) / CellSize);
+	const int32 Y = FMath::FloorToInt((Location.Y - Origin.Y) / CellSize);
+	if (X < 0 || Y < 0 || X >= SizeX || Y >= SizeY)
+		return false;
+
+	const int32 CellIndex = Y * SizeX + X;
+	const uint8 Cell = Cells[CellIndex];
+	if (Cell == 0)
+		return false;
+
+	// Only the highest floor of a cell is baked, anything else (e.g. the ground floor below a bridge) needs a trace
+	const float Height = Origin.Z + Heights[CellIndex];
+	if (FMath::Abs(Location.Z - Height) > MaxHeightDifference)
+		return false;
+
+	OutSurface = Surfaces[Cell - 1];
+	return true;
+}
+
+#if WITH_EDITOR
+void UFirstPersonSurfaceMap::Bake(UWorld* World, const FBox& Bounds, const float NewCellSize, const ECollisionChannel TraceChannel)
+{
+	Origin = Bounds.Min;
+	CellSize = FMath::Max(NewCellSize, 1.0f);
+	SizeX = FMath::CeilToInt((Bounds.Max.X - Bounds.Min.X) / CellSize);
+	SizeY = FMath::CeilToInt((Bounds.Max.Y - Bounds.Min.Y) / CellSize);
+
+	Surfaces.Reset();
+	Cells.Init(0, SizeX * SizeY);
+	Heights.Init(0, SizeX * SizeY);
+
+	// Complex collision gives us per-face materials and landscape layers
+	FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(BakeSurfaceMap), true);
+	TraceParams.bReturnPhysicalMaterial = true;
+
+	const float WalkableFloorZ = 0.71f; // ~45 degrees, the character movement default
+
+	for (int32 Y = 0; Y < SizeY; Y++)
+	{
+		for (int32 X = 0; X < SizeX; X++)
+		{
+			const FVector CellCenter = Origin + FVector((X + 0.5f) * CellSize, (Y + 0.5f) * CellSize, 0.0f);
+			const FVector Start(CellCenter.X, CellCenter.Y, Bounds.Max.Z);
+			const FVector End(CellCenter.X, CellCenter.Y, Bounds.Min.Z);
+
+			FHitResult Hit;
+			if (!World->LineTraceSingleByChannel(Hit, Start, End, TraceChannel, TraceParams))
+				continue;
+
+			// Movable floors can change at runtime, leave them to the trace path
+			const UPrimitiveComponent* HitComponent = Hit.GetComponent();
+			if (!HitComponent || HitComponent->Mobility != EComponentMobility::Static || Hit.ImpactNormal.Z < WalkableFloorZ)
+				continue;
+
+			UPhysicalMaterial* Surface = Hit.PhysMaterial.Get();
+			if (!Surface)
+				continue;
+
+			const int32 SurfaceIndex = Surfaces.AddUnique(Surface);
+			if (SurfaceIndex >= MAX_uint8)
+			{
+				UE_LOG(LogFirstPersonCharacter, Warning, TEXT("%s: too many physical materials, %s will use traces"), *GetName(), *Surface->GetName())
+				Surfaces.RemoveAt(SurfaceIndex);
+				continue;
+			}
+
+			const int32 CellIndex = Y * SizeX + X;
+			Cells[CellIndex] = static_cast<uint8>(SurfaceIndex + 1);
+			Heights[CellIndex] = static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Hit.ImpactPoint.Z - Origin.Z), static_cast<int32>(MIN_int16), static_cast<int32>(MAX_int16)));
+		}
+	}
+
+	MarkPackageDirty();
+}
+#endif
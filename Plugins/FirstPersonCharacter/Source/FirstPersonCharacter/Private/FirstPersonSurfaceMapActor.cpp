@@ -0,0 +1,61 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonSurfaceMapActor.h"
+#include "FirstPersonCharacter.h"
+#include "FirstPersonCharacterSubsystem.h"
+#include "FirstPersonSurfaceMap.h"
+
+#include "Components/BoxComponent.h"
+
+#include "Misc/PackageName.h"
+
+AFirstPersonSurfaceMapActor::AFirstPersonSurfaceMapActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	BoundsComponent = CreateDefaultSubobject<UBoxComponent>(FName("BoundsComponent"));
+	BoundsComponent->SetBoxExtent(FVector(2000.0f, 2000.0f, 500.0f));
+	BoundsComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	BoundsComponent->SetMobility(EComponentMobility::Static);
+	RootComponent = BoundsComponent;
+}
+
+void AFirstPersonSurfaceMapActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (SurfaceMap && !SurfaceMap->IsEmpty())
+	{
+		if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+			CharacterSubsystem->RegisterSurfaceMap(this);
+	}
+}
+
+void AFirstPersonSurfaceMapActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFirstPersonCharacterSubsystem* CharacterSubsystem = GetWorld()->GetSubsystem<UFirstPersonCharacterSubsystem>())
+		CharacterSubsystem->UnregisterSurfaceMap(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+#if WITH_EDITOR
+void AFirstPersonSurfaceMapActor::BakeSurfaceMap()
+{
+	if (!SurfaceMap)
+	{
+		// Store the asset next to the level that owns this actor
+		const FString LevelPackageName = GetOutermost()->GetName();
+		const FString AssetName = FString::Printf(TEXT("%s_SurfaceMap_%s"), *FPackageName::GetShortName(LevelPackageName), *GetName());
+		const FString PackageName = FPackageName::GetLongPackagePath(LevelPackageName) / AssetName;
+
+		UPackage* Package = CreatePackage(*PackageName);
+		SurfaceMap = NewObject<UFirstPersonSurfaceMap>(Package, *AssetName, RF_Public | RF_Standalone);
+		MarkPackageDirty();
+	}
+
+	SurfaceMap->Bake(GetWorld(), BoundsComponent->Bounds.GetBox(), CellSize, TraceChannel);
+
+	UE_LOG(LogFirstPersonCharacter, Log, TEXT("Baked %s with %d surfaces"), *SurfaceMap->GetPathName(), SurfaceMap->GetSurfaces().Num())
+}
+#endif
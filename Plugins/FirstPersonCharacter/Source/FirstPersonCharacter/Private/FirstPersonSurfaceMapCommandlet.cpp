@@ -0,0 +1,123 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonSurfaceMapCommandlet.h"
+#include "FirstPersonCharacter.h"
+#include "FirstPersonSurfaceMap.h"
+#include "FirstPersonSurfaceMapActor.h"
+
+#include "Engine/LevelStreaming.h"
+#include "Engine/World.h"
+
+#include "EngineUtils.h"
+
+#include "Misc/PackageName.h"
+
+#include "UObject/Package.h"
+
+UFirstPersonSurfaceMapCommandlet::UFirstPersonSurfaceMapCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UFirstPersonSurfaceMapCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString MapList;
+	if (!FParse::Value(*Params, TEXT("Maps="), MapList, false))
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("Usage: -run=FirstPersonSurfaceMap -Maps=/Game/Maps/MapA+/Game/Maps/MapB"))
+		return 1;
+	}
+
+	TArray<FString> MapNames;
+	MapList.ParseIntoArray(MapNames, TEXT("+"));
+
+	int32 NumFailed = 0;
+	for (const FString& MapName : MapNames)
+	{
+		if (!BakeMap(MapName))
+			NumFailed++;
+	}
+
+	return NumFailed > 0 ? 1 : 0;
+#else
+	return 1;
+#endif
+}
+
+bool UFirstPersonSurfaceMapCommandlet::BakeMap(const FString& MapName)
+{
+#if WITH_EDITOR
+	UPackage* MapPackage = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogFirstPersonCharacter, Error, TEXT("Couldn't load map %s"), *MapName)
+		return false;
+	}
+
+	// We only need collision, no rendering, audio or navigation
+	World->WorldType = EWorldType::Editor;
+	World->AddToRoot();
+	if (!World->bIsWorldInitialized)
+	{
+		UWorld::InitializationValues InitializationValues;
+		InitializationValues
+			.RequiresHitProxies(false)
+			.ShouldSimulatePhysics(false)
+			.EnableTraceCollision(true)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(true);
+
+		World->InitWorld(InitializationValues);
+	}
+
+	World->UpdateWorldComponents(true, false);
+
+	// Streaming levels can hold their own surface maps and the geometry below them
+	for (ULevelStreaming* StreamingLevel : World->GetStreamingLevels())
+	{
+		StreamingLevel->SetShouldBeLoaded(true);
+		StreamingLevel->SetShouldBeVisible(true);
+	}
+	World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+	TArray<UPackage*> PackagesToSave;
+	for (TActorIterator<AFirstPersonSurfaceMapActor> It(World); It; ++It)
+	{
+		It->BakeSurfaceMap();
+
+		PackagesToSave.AddUnique(It->GetOutermost());
+		PackagesToSave.AddUnique(It->GetSurfaceMap()->GetOutermost());
+	}
+
+	if (PackagesToSave.Num() == 0)
+		UE_LOG(LogFirstPersonCharacter, Warning, TEXT("%s has no FirstPersonSurfaceMapActor"), *MapName)
+
+	bool bSaved = true;
+	for (UPackage* Package : PackagesToSave)
+	{
+		const bool bIsMap = Package->ContainsMap();
+		const FString FileName = FPackageName::LongPackageNameToFilename(Package->GetName(), bIsMap ? FPackageName::GetMapPackageExtension() : FPackageName::GetAssetPackageExtension());
+		UObject* Base = bIsMap ? static_cast<UObject*>(UWorld::FindWorldInPackage(Package)) : nullptr;
+
+		if (!UPackage::SavePackage(Package, Base, RF_Standalone, *FileName))
+		{
+			UE_LOG(LogFirstPersonCharacter, Error, TEXT("Couldn't save %s"), *FileName)
+			bSaved = false;
+		}
+	}
+
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+
+	return bSaved;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,333 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonBotController.h"
+#include "FirstPersonBotSpawner.h"
+#include "FirstPersonCharacterStats.h"
+#include "FirstPersonCharacterTestAccess.h"
+#include "FirstPersonClearanceSubsystem.h"
+#include "FirstPersonFootstepAudioSubsystem.h"
+#include "FirstPersonScenarioCommand.h"
+#include "FPCharacter.h"
+
+#include "Components/CapsuleComponent.h"
+#include "Components/PrimitiveComponent.h"
+
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+#include "Misc/App.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+#include "Sound/SoundWave.h"
+
+#include "Tests/AutomationCommon.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && CSV_PROFILER
+
+namespace FirstPersonBenchmark
+{
+	const int32 BotCounts[] = { 1, 10, 100, 500 };
+
+	// Lets the bots spread out and start running, crouching and jumping before the capture
+	const int32 WarmupFrames = 120;
+	const int32 CaptureFrames = 600;
+
+	// High above the map, so the course is the same in every map
+	const float CourseHeight = 10000.0f;
+	const float CourseRadius = 5000.0f;
+
+	// Every bot crouches for a while every few seconds, and walks into the ceilings on the way
+	const float CrouchInterval = 4.0f;
+	const float CrouchDuration = 1.5f;
+	const int32 CeilingsPerSide = 8;
+	const float CeilingSize = 400.0f;
+
+	/**
+	 * A floor with a footstep mapping for its surface and a grid of low ceilings that only crouched characters fit under.
+	 * Bots that stand up under one keep sweeping for clearance until they've walked out again
+	 */
+	struct FCourse
+	{
+		TArray<TWeakObjectPtr<AActor>> Boxes;
+		TWeakObjectPtr<UFirstPersonFootstepData> Mapping;
+		TWeakObjectPtr<USoundBase> Sound;
+		FVector FloorTop = FVector::ZeroVector;
+
+		bool Spawn(UWorld& World)
+		{
+			const FVector FloorExtent(CourseRadius + 500.0f, CourseRadius + 500.0f, 10.0f);
+			const FVector FloorLocation = FirstPersonTest::GetTestLocation(World) + FVector(0.0f, 0.0f, CourseHeight);
+			AActor* Floor = FirstPersonTest::SpawnBox(World, FloorLocation, FloorExtent);
+			if (!Floor)
+				return false;
+
+			Boxes.Add(Floor);
+			FloorTop = FloorLocation + FVector(0.0f, 0.0f, FloorExtent.Z);
+
+			// The mapping only holds on to its sound softly
+			UPhysicalMaterial* Surface = NewObject<UPhysicalMaterial>(GetTransientPackage());
+			USoundWave* NewSound = NewObject<USoundWave>(GetTransientPackage());
+			NewSound->AddToRoot();
+			Sound = NewSound;
+			Mapping = FFirstPersonCharacterTestAccess::NewFootstepData(Surface, NewSound);
+			CastChecked<UPrimitiveComponent>(Floor->GetRootComponent())->SetPhysMaterialOverride(Surface);
+
+			// Halfway between the top of a crouched and a standing character
+			const float StandingHalfHeight = GetDefault<AFPCharacter>()->GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight();
+			const FVector CeilingExtent(CeilingSize / 2.0f, CeilingSize / 2.0f, 10.0f);
+			const float CeilingZ = FloorTop.Z + 1.5f * StandingHalfHeight + CeilingExtent.Z;
+			const float Spacing = 2.0f * CourseRadius / CeilingsPerSide;
+
+			for (int32 X = 0; X < CeilingsPerSide; X++)
+			{
+				for (int32 Y = 0; Y < CeilingsPerSide; Y++)
+				{
+					const FVector CeilingLocation(FloorTop.X - CourseRadius + (X + 0.5f) * Spacing, FloorTop.Y - CourseRadius + (Y + 0.5f) * Spacing, CeilingZ);
+					if (AActor* Ceiling = FirstPersonTest::SpawnBox(World, CeilingLocation, CeilingExtent))
+						Boxes.Add(Ceiling);
+				}
+			}
+
+			return true;
+		}
+
+		void Destroy()
+		{
+			for (const TWeakObjectPtr<AActor>& Box : Boxes)
+			{
+				if (Box.IsValid())
+					Box->Destroy();
+			}
+			Boxes.Reset();
+
+			if (Sound.IsValid())
+				Sound->RemoveFromRoot();
+		}
+	};
+
+	// What one bot count measured, written next to its CSV profile
+	struct FResult
+	{
+		int32 BotsRequested = 0;
+		int32 Bots = 0;
+		int32 Frames = 0;
+		double TotalFrameTime = 0.0;
+		double MaxFrameTime = 0.0;
+		int32 FootstepsPlayedAtStart = 0;
+		int32 FootstepsPlayed = 0;
+		int32 SweepsAtStart = 0;
+		int32 Sweeps = 0;
+
+		FString ToCsv() const
+		{
+			const double AverageFrameTime = Frames > 0 ? TotalFrameTime / Frames : 0.0;
+			return FString::Printf(TEXT("BotsRequested,Bots,Frames,AverageFrameMs,MaxFrameMs,FootstepsPlayed,ClearanceSweeps\n%d,%d,%d,%.3f,%.3f,%d,%d\n"),
+				BotsRequested, Bots, Frames, AverageFrameTime * 1000.0, MaxFrameTime * 1000.0, FootstepsPlayed - FootstepsPlayedAtStart, Sweeps - SweepsAtStart);
+		}
+	};
+}
+
+/**
+ * Spawns each number of bots in turn on an obstacle course high above the first player start, and captures a CSV profile of them.
+ * The bots crouch on a schedule and have a footstep mapping for the course floor, so every bot count exercises the same work.
+ * Every bot count gets its own files, the CSV profile in Saved/Profiling/CSV and a summary in Saved/Profiling/FirstPersonBenchmark
+ */
+class FFirstPersonBenchmarkCommand : public IAutomationLatentCommand
+{
+public:
+	explicit FFirstPersonBenchmarkCommand(FAutomationTestBase* InTest) : Test(InTest) {}
+
+	bool Update() override;
+
+private:
+	enum class EStep : uint8
+	{
+		Spawn,
+		Warmup,
+		Capture,
+		WriteFile
+	};
+
+	AFirstPersonBotSpawner* SpawnBots(UWorld& World, int32 NumBots) const;
+	void Cleanup();
+
+	FAutomationTestBase* Test;
+	EStep Step = EStep::Spawn;
+	int32 RunIndex = 0;
+	int32 FramesLeft = 0;
+	FirstPersonBenchmark::FCourse Course;
+	FirstPersonBenchmark::FResult Result;
+	TWeakObjectPtr<AFirstPersonBotSpawner> Spawner;
+	TSharedFuture<FString> CsvFile;
+};
+
+bool FFirstPersonBenchmarkCommand::Update()
+{
+	using namespace FirstPersonBenchmark;
+
+	UWorld* World = AutomationCommon::GetAnyGameWorld();
+	if (!World)
+	{
+		Test->AddError(TEXT("The benchmark needs a game world, run it with -game or in PIE"));
+		return true;
+	}
+
+	FCsvProfiler* CsvProfiler = FCsvProfiler::Get();
+	const UFirstPersonFootstepAudioSubsystem* FootstepAudio = World->GetSubsystem<UFirstPersonFootstepAudioSubsystem>();
+	const UFirstPersonClearanceSubsystem* Clearance = World->GetSubsystem<UFirstPersonClearanceSubsystem>();
+	const int32 NumBots = BotCounts[RunIndex];
+
+	switch (Step)
+	{
+		case EStep::Spawn:
+			if (CsvProfiler->IsCapturing())
+			{
+				Test->AddError(TEXT("A CSV capture is already running"));
+				return true;
+			}
+
+			if (!Course.Spawn(*World))
+			{
+				Test->AddError(TEXT("Couldn't spawn the obstacle course"));
+				Course.Destroy();
+				return true;
+			}
+
+			Spawner = SpawnBots(*World, NumBots);
+			if (!Spawner.IsValid())
+			{
+				Test->AddError(TEXT("Couldn't spawn the bot spawner"));
+				Course.Destroy();
+				return true;
+			}
+
+			FramesLeft = WarmupFrames;
+			Step = EStep::Warmup;
+			return false;
+
+		case EStep::Warmup:
+			if (Spawner.IsValid() && Spawner->IsSpawning())
+				return false;
+
+			// All bots are there now, put them on the same crouch schedule
+			if (FramesLeft == WarmupFrames)
+			{
+				for (TActorIterator<AFirstPersonBotController> It(World); It; ++It)
+					It->SetCrouchSchedule(CrouchInterval, CrouchDuration);
+			}
+
+			if (--FramesLeft > 0)
+				return false;
+
+			// Spots under a ceiling don't get a bot, the files record how many there really were
+			if (!Spawner.IsValid() || Spawner->GetNumBots() < NumBots)
+				Test->AddWarning(FString::Printf(TEXT("Only %d of %d bots spawned"), Spawner.IsValid() ? Spawner->GetNumBots() : 0, NumBots));
+
+			Result = FResult();
+			Result.BotsRequested = NumBots;
+			Result.Bots = Spawner.IsValid() ? Spawner->GetNumBots() : 0;
+			Result.FootstepsPlayedAtStart = FootstepAudio ? FootstepAudio->GetNumFootstepsPlayed() : 0;
+			Result.SweepsAtStart = Clearance ? Clearance->GetNumSweepsIssued() : 0;
+
+			CsvProfiler->BeginCapture(-1, FString(), FString::Printf(TEXT("FirstPersonBenchmark_%dBots.csv"), NumBots));
+			CSV_METADATA(TEXT("FirstPersonBotsRequested"), *FString::FromInt(NumBots));
+			CSV_METADATA(TEXT("FirstPersonBots"), *FString::FromInt(Result.Bots));
+
+			FramesLeft = CaptureFrames;
+			Step = EStep::Capture;
+			return false;
+
+		case EStep::Capture:
+			// The capture starts with the next frame
+			if (!CsvProfiler->IsCapturing())
+				return false;
+
+			Result.Frames++;
+			Result.TotalFrameTime += FApp::GetDeltaTime();
+			Result.MaxFrameTime = FMath::Max(Result.MaxFrameTime, FApp::GetDeltaTime());
+
+			if (--FramesLeft > 0)
+				return false;
+
+			Result.FootstepsPlayed = FootstepAudio ? FootstepAudio->GetNumFootstepsPlayed() : 0;
+			Result.Sweeps = Clearance ? Clearance->GetNumSweepsIssued() : 0;
+
+			CsvFile = CsvProfiler->EndCapture();
+			Step = EStep::WriteFile;
+			return false;
+
+		case EStep::WriteFile:
+		{
+			if (!CsvFile.IsReady())
+				return false;
+
+			const FString ResultFile = FPaths::ProfilingDir() / TEXT("FirstPersonBenchmark") / FString::Printf(TEXT("FirstPersonBenchmark_%dBots.csv"), NumBots);
+			if (!FFileHelper::SaveStringToFile(Result.ToCsv(), *ResultFile))
+				Test->AddError(FString::Printf(TEXT("Couldn't write %s"), *ResultFile));
+
+			Test->AddInfo(FString::Printf(TEXT("%d bots: %s, %s"), NumBots, *ResultFile, *CsvFile.Get()));
+			Cleanup();
+
+			Step = EStep::Spawn;
+			return ++RunIndex == UE_ARRAY_COUNT(BotCounts);
+		}
+	}
+
+	return true;
+}
+
+AFirstPersonBotSpawner* FFirstPersonBenchmarkCommand::SpawnBots(UWorld& World, const int32 NumBots) const
+{
+	// Low enough that the floor search starts under the ceilings
+	const FVector Location = Course.FloorTop + FVector(0.0f, 0.0f, 20.0f);
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.bDeferConstruction = true;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AFirstPersonBotSpawner* NewSpawner = World.SpawnActor<AFirstPersonBotSpawner>(Location, FRotator::ZeroRotator, SpawnParameters);
+	if (!NewSpawner)
+		return nullptr;
+
+	// The default seed, so every build is measured with the same bots doing the same things
+	NewSpawner->SetNumBots(NumBots);
+	NewSpawner->SetFootstepMappings({ Course.Mapping.Get() });
+	NewSpawner->FinishSpawning(FTransform(Location));
+
+	return NewSpawner;
+}
+
+void FFirstPersonBenchmarkCommand::Cleanup()
+{
+	if (Spawner.IsValid())
+	{
+		Spawner->DestroyBots();
+		Spawner->Destroy();
+		Spawner.Reset();
+	}
+
+	Course.Destroy();
+}
+
+// Run headless with: UE4Editor <Project> <Map> -game -nullrhi -unattended -ExecCmds="Automation RunTests FirstPersonCharacter.Benchmark; Quit"
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstPersonCharacterBenchmarkTest, "FirstPersonCharacter.Benchmark.BotScaling", EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FFirstPersonCharacterBenchmarkTest::RunTest(const FString& Parameters)
+{
+	// Optionally benchmark on another map than the one that's open
+	FString MapName;
+	if (FParse::Value(FCommandLine::Get(), TEXT("FirstPersonBenchmarkMap="), MapName))
+		AutomationOpenMap(MapName);
+
+	FCsvProfiler::Get()->EnableCategoryByString(TEXT("FirstPersonCharacter"));
+	ADD_LATENT_AUTOMATION_COMMAND(FFirstPersonBenchmarkCommand(this));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,716 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonCameraShakeComponent.h"
+#include "FirstPersonCharacterTestAccess.h"
+#include "FirstPersonClearanceSubsystem.h"
+#include "FirstPersonScenarioCommand.h"
+#include "FirstPersonTestCameraShake.h"
+#include "FPCharacter.h"
+
+#include "AIController.h"
+
+#include "Components/CapsuleComponent.h"
+
+#include "Engine/World.h"
+
+#include "GameFramework/PlayerController.h"
+
+#include "HAL/FileManager.h"
+
+#include "Misc/AutomationTest.h"
+#include "Misc/ConfigCacheIni.h"
+
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+#include "Sound/SoundWave.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace FirstPersonBudget
+{
+	// A transition to running starts the walk and the run shake, every other transition a single one
+	const int32 MaxShakesPerTransition = 2;
+
+	// Per character, while a held crouch is being released. Standing characters don't sweep at all
+	const int32 MaxSweepsPerFrame = 1;
+
+	// Walking on the ground reuses the floor the movement found, a footstep only sweeps when that isn't there
+	const int32 MaxFloorSweepsPerFootstep = 0;
+
+	// The floor surface cache keeps a lookup per floor face, a single floor only needs one
+	const int32 MaxMaterialLookupsPerFloor = 1;
+
+	// Steady state walking and footsteps reuse what the first frames allocated
+	const int32 MaxSteadyStateAllocations = 0;
+
+	float GetStandingHalfHeight()
+	{
+		return GetDefault<AFPCharacter>()->GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight();
+	}
+
+	/**
+	 * A floor high above the map with a footstep mapping for its surface, and an AI controlled character standing on it.
+	 * Nothing of the map is in the way, and every footstep on it is mapped
+	 */
+	struct FFootstepCourse
+	{
+		TWeakObjectPtr<AFPCharacter> Character;
+		TWeakObjectPtr<AActor> Floor;
+		TWeakObjectPtr<UFirstPersonFootstepData> Mapping;
+		TWeakObjectPtr<USoundBase> Sound;
+
+		bool Spawn(FAutomationTestBase& Test, UWorld& World)
+		{
+			const FVector Extent(2000.0f, 2000.0f, 10.0f);
+			const FVector FloorLocation = FirstPersonTest::GetTestLocation(World) + FVector(0.0f, 0.0f, 5000.0f);
+			AActor* NewFloor = FirstPersonTest::SpawnBox(World, FloorLocation, Extent);
+			if (!NewFloor)
+			{
+				Test.AddError(TEXT("Couldn't spawn the floor"));
+				return false;
+			}
+
+			// The mapping only holds on to its sound softly
+			UPhysicalMaterial* Surface = NewObject<UPhysicalMaterial>(GetTransientPackage());
+			USoundWave* NewSound = NewObject<USoundWave>(GetTransientPackage());
+			NewSound->AddToRoot();
+			Sound = NewSound;
+			Floor = NewFloor;
+
+			UPrimitiveComponent* FloorComponent = CastChecked<UPrimitiveComponent>(NewFloor->GetRootComponent());
+			FloorComponent->SetPhysMaterialOverride(Surface);
+
+			const FVector CharacterLocation = FloorLocation + FVector(0.0f, 0.0f, Extent.Z + GetStandingHalfHeight() + 2.0f);
+			AFPCharacter* NewCharacter = FirstPersonTest::BeginSpawnCharacter(World, CharacterLocation);
+			if (!NewCharacter)
+			{
+				Test.AddError(TEXT("Couldn't spawn the character"));
+				return false;
+			}
+
+			UFirstPersonFootstepData* NewMapping = FFirstPersonCharacterTestAccess::NewFootstepData(Surface, NewSound);
+			FFirstPersonCharacterTestAccess::SetFootstepMappings(*NewCharacter, { NewMapping });
+			Mapping = NewMapping;
+
+			// A controller that stays put, the steps drive the character
+			NewCharacter->AutoPossessAI = EAutoPossessAI::Spawned;
+			NewCharacter->AIControllerClass = AAIController::StaticClass();
+			NewCharacter->FinishSpawning(NewCharacter->GetActorTransform());
+
+			Character = NewCharacter;
+			return true;
+		}
+
+		void Destroy()
+		{
+			if (Character.IsValid())
+			{
+				if (AController* Controller = Character->GetController())
+					Controller->Destroy();
+
+				Character->Destroy();
+			}
+
+			if (Floor.IsValid())
+				Floor->Destroy();
+
+			if (Sound.IsValid())
+				Sound->RemoveFromRoot();
+		}
+	};
+
+	/**
+	 * Counts the allocations of the game thread between Begin and End, by standing in for GMalloc while installed.
+	 * It's never deleted, another thread may still be inside it after it's uninstalled
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		static FCountingMalloc& Get()
+		{
+			static FCountingMalloc* Instance = new FCountingMalloc();
+			return *Instance;
+		}
+
+		void Install()
+		{
+			check(GMalloc != this);
+			Inner = GMalloc;
+			GMalloc = this;
+		}
+
+		void Uninstall()
+		{
+			if (GMalloc == this)
+				GMalloc = Inner;
+		}
+
+		void Begin() { bCounting = true; NumAllocations = 0; }
+		int32 End() { bCounting = false; return NumAllocations; }
+
+		void* Malloc(SIZE_T Count, uint32 Alignment) override { CountAllocation(); return Inner->Malloc(Count, Alignment); }
+		void* TryMalloc(SIZE_T Count, uint32 Alignment) override { CountAllocation(); return Inner->TryMalloc(Count, Alignment); }
+		void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override { CountAllocation(); return Inner->Realloc(Original, Count, Alignment); }
+		void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override { CountAllocation(); return Inner->TryRealloc(Original, Count, Alignment); }
+		void Free(void* Original) override { Inner->Free(Original); }
+		SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		void UpdateStats() override { Inner->UpdateStats(); }
+		void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+	private:
+		void CountAllocation()
+		{
+			if (bCounting && IsInGameThread())
+				NumAllocations++;
+		}
+
+		FMalloc* Inner = nullptr;
+		volatile bool bCounting = false;
+		int32 NumAllocations = 0;
+	};
+
+	// When the config files that input settings live in were last written, and which ones have unsaved changes.
+	// The editor saves its own settings whenever it likes, so they're left out
+	struct FConfigSnapshot
+	{
+		TArray<FString> Filenames;
+		TMap<FString, FDateTime> TimeStamps;
+		TSet<FString> DirtyFiles;
+
+		void Take()
+		{
+			Filenames = { GInputIni, GGameIni, GGameUserSettingsIni };
+
+			for (const FString& Filename : Filenames)
+			{
+				TimeStamps.Add(Filename, IFileManager::Get().GetTimeStamp(*Filename));
+
+				const FConfigFile* ConfigFile = GConfig->FindConfigFile(Filename);
+				if (ConfigFile && ConfigFile->Dirty)
+					DirtyFiles.Add(Filename);
+			}
+		}
+
+		void CheckUnchanged(FAutomationTestBase& Test, const FString& When) const
+		{
+			for (const FString& Filename : Filenames)
+			{
+				const FConfigFile* ConfigFile = GConfig->FindConfigFile(Filename);
+				if (ConfigFile && ConfigFile->Dirty && !DirtyFiles.Contains(Filename))
+					Test.AddError(FString::Printf(TEXT("%s was changed %s"), *Filename, *When));
+
+				const FDateTime* TimeStamp = TimeStamps.Find(Filename);
+				if (TimeStamp && *TimeStamp != IFileManager::Get().GetTimeStamp(*Filename))
+					Test.AddError(FString::Printf(TEXT("%s was saved %s"), *Filename, *When));
+			}
+		}
+	};
+}
+
+// Run headless with: UE4Editor <Project> <Map> -game -nullrhi -unattended -ExecCmds="Automation RunTests FirstPersonCharacter.Budget; Quit"
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstPersonShakeBudgetTest, "FirstPersonCharacter.Budget.CameraShakeStarts", EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FFirstPersonShakeBudgetTest::RunTest(const FString& Parameters)
+{
+	using namespace FirstPersonBudget;
+	using namespace FirstPersonTest;
+
+	struct FScenario
+	{
+		TWeakObjectPtr<AFPCharacter> Character;
+		TWeakObjectPtr<APlayerController> PlayerController;
+		TWeakObjectPtr<APawn> PreviousPawn;
+		TWeakObjectPtr<UFirstPersonCameraShakeComponent> ShakeComponent;
+		FVector2D Move = FVector2D::ZeroVector;
+		int32 ShakesAtStepBegin = 0;
+
+		int32 GetNumShakesStarted() const { return ShakeComponent.IsValid() ? ShakeComponent->GetNumShakesStarted() : 0; }
+	};
+	const TSharedRef<FScenario> Scenario = MakeShared<FScenario>();
+
+	const auto Setup = [this, Scenario](UWorld& World)
+	{
+		APlayerController* PlayerController = World.GetFirstPlayerController();
+		if (!PlayerController)
+		{
+			AddError(TEXT("Locomotion shakes only play for a local player, but there is none"));
+			return false;
+		}
+
+		AFPCharacter* Character = BeginSpawnCharacter(World, GetTestLocation(World));
+		if (!Character)
+		{
+			AddError(TEXT("Couldn't spawn the character"));
+			return false;
+		}
+
+		FCameraShakes Shakes;
+		Shakes.IdleShake = UFirstPersonTestCameraShake::StaticClass();
+		Shakes.WalkShake = UFirstPersonTestCameraShake::StaticClass();
+		Shakes.RunShake = UFirstPersonTestCameraShake::StaticClass();
+		FFirstPersonCharacterTestAccess::SetCameraShakes(*Character, Shakes);
+
+		Character->FinishSpawning(Character->GetActorTransform());
+
+		Scenario->PlayerController = PlayerController;
+		Scenario->PreviousPawn = PlayerController->GetPawn();
+		Scenario->Character = Character;
+		Scenario->ShakeComponent = Character->FindComponentByClass<UFirstPersonCameraShakeComponent>();
+
+		PlayerController->Possess(Character);
+		return true;
+	};
+
+	const auto Cleanup = [Scenario]()
+	{
+		if (Scenario->Character.IsValid())
+			Scenario->Character->Destroy();
+
+		if (Scenario->PlayerController.IsValid() && Scenario->PreviousPawn.IsValid())
+			Scenario->PlayerController->Possess(Scenario->PreviousPawn.Get());
+	};
+
+	// A budget of INDEX_NONE isn't checked
+	const auto MakeStep = [this, Scenario](const FString& Name, const float Duration, const FVector2D Move, const bool bRun, const bool bJump, const int32 MaxShakes)
+	{
+		FFirstPersonScenarioStep Step;
+		Step.Duration = Duration;
+		Step.Begin = [Scenario, Move, bRun, bJump]()
+		{
+			Scenario->Move = Move;
+			Scenario->ShakesAtStepBegin = Scenario->GetNumShakesStarted();
+
+			if (AFPCharacter* Character = Scenario->Character.Get())
+			{
+				Character->SetRunIntent(bRun);
+				Character->SetJumpIntent(bJump);
+			}
+		};
+		Step.Tick = [Scenario]()
+		{
+			if (AFPCharacter* Character = Scenario->Character.Get())
+			{
+				if (!Scenario->Move.IsZero())
+					Character->AddMoveIntent(Scenario->Move);
+			}
+		};
+		Step.End = [this, Scenario, Name, MaxShakes](int32)
+		{
+			if (MaxShakes != INDEX_NONE)
+				CheckBudget(*this, FString::Printf(TEXT("Camera shakes started while %s"), *Name), Scenario->GetNumShakesStarted() - Scenario->ShakesAtStepBegin, MaxShakes);
+		};
+		return Step;
+	};
+
+	// Walk forward and run back, so the character stays near its start and doesn't stop at a wall.
+	// Turning around and stopping pass through another state on the way, so they may take two transitions
+	const FVector2D Forward(1.0f, 0.0f);
+	TArray<FFirstPersonScenarioStep> Steps;
+	Steps.Add(MakeStep(TEXT("landing after the spawn"), 1.0f, FVector2D::ZeroVector, false, false, INDEX_NONE));
+	Steps.Add(MakeStep(TEXT("standing still"), 1.0f, FVector2D::ZeroVector, false, false, 0));
+	Steps.Add(MakeStep(TEXT("starting to walk"), 0.5f, Forward, false, false, MaxShakesPerTransition));
+	Steps.Add(MakeStep(TEXT("walking"), 0.5f, Forward, false, false, 0));
+	Steps.Add(MakeStep(TEXT("starting to run"), 0.5f, -Forward, true, false, MaxShakesPerTransition * 2));
+	Steps.Add(MakeStep(TEXT("running"), 0.5f, -Forward, true, false, 0));
+	Steps.Add(MakeStep(TEXT("stopping"), 1.0f, FVector2D::ZeroVector, false, false, MaxShakesPerTransition * 2));
+	Steps.Add(MakeStep(TEXT("standing still"), 1.0f, FVector2D::ZeroVector, false, false, 0));
+	Steps.Add(MakeStep(TEXT("jumping and landing"), 1.5f, FVector2D::ZeroVector, false, true, MaxShakesPerTransition * 2));
+	Steps.Add(MakeStep(TEXT("standing still"), 1.0f, FVector2D::ZeroVector, false, false, 0));
+
+	// Without a single shake the budgets above don't mean anything
+	Steps.Last().End = [this, Scenario, End = Steps.Last().End](const int32 NumFrames)
+	{
+		End(NumFrames);
+		TestTrue(TEXT("Locomotion shakes were started"), Scenario->GetNumShakesStarted() > 0);
+	};
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFirstPersonScenarioCommand(this, Setup, MoveTemp(Steps), Cleanup));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstPersonSweepBudgetTest, "FirstPersonCharacter.Budget.ClearanceSweeps", EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FFirstPersonSweepBudgetTest::RunTest(const FString& Parameters)
+{
+	using namespace FirstPersonBudget;
+	using namespace FirstPersonTest;
+
+	struct FScenario
+	{
+		TWeakObjectPtr<AFPCharacter> Character;
+		TWeakObjectPtr<AActor> Obstacle;
+		TWeakObjectPtr<UFirstPersonClearanceSubsystem> ClearanceSubsystem;
+		int32 SweepsAtStepBegin = 0;
+
+		int32 GetNumSweepsIssued() const { return ClearanceSubsystem.IsValid() ? ClearanceSubsystem->GetNumSweepsIssued() : 0; }
+		float GetHalfHeight() const { return Character.IsValid() ? Character->GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight() : 0.0f; }
+	};
+	const TSharedRef<FScenario> Scenario = MakeShared<FScenario>();
+
+	const auto Setup = [this, Scenario](UWorld& World)
+	{
+		Scenario->ClearanceSubsystem = World.GetSubsystem<UFirstPersonClearanceSubsystem>();
+		if (!Scenario->ClearanceSubsystem.IsValid())
+		{
+			AddError(TEXT("The world has no clearance subsystem"));
+			return false;
+		}
+
+		AFPCharacter* Character = BeginSpawnCharacter(World, GetTestLocation(World));
+		if (!Character)
+		{
+			AddError(TEXT("Couldn't spawn the character"));
+			return false;
+		}
+
+		// A controller that stays put, the steps drive the character
+		Character->AutoPossessAI = EAutoPossessAI::Spawned;
+		Character->AIControllerClass = AAIController::StaticClass();
+		Character->FinishSpawning(Character->GetActorTransform());
+
+		Scenario->Character = Character;
+		return true;
+	};
+
+	const auto Cleanup = [Scenario]()
+	{
+		if (Scenario->Obstacle.IsValid())
+			Scenario->Obstacle->Destroy();
+
+		if (Scenario->Character.IsValid())
+		{
+			if (AController* Controller = Scenario->Character->GetController())
+				Controller->Destroy();
+
+			Scenario->Character->Destroy();
+		}
+	};
+
+	const auto MakeStep = [this, Scenario](const FString& Name, const float Duration, TFunction<void()> Begin, const int32 MaxSweeps)
+	{
+		FFirstPersonScenarioStep Step;
+		Step.Duration = Duration;
+		Step.Begin = [Scenario, Begin]()
+		{
+			Scenario->SweepsAtStepBegin = Scenario->GetNumSweepsIssued();
+
+			if (Begin)
+				Begin();
+		};
+		Step.End = [this, Scenario, Name, MaxSweeps](const int32 NumFrames)
+		{
+			// The world may tick once more than the step, depending on when the latent commands run in the frame
+			if (MaxSweeps != INDEX_NONE)
+				CheckBudget(*this, FString::Printf(TEXT("Clearance sweeps while %s (%d frames)"), *Name, NumFrames), Scenario->GetNumSweepsIssued() - Scenario->SweepsAtStepBegin, MaxSweeps * (NumFrames + 1));
+		};
+		return Step;
+	};
+
+	const auto SetCrouchIntent = [Scenario](const bool bCrouch)
+	{
+		return [Scenario, bCrouch]()
+		{
+			if (Scenario->Character.IsValid())
+				Scenario->Character->SetCrouchIntent(bCrouch);
+		};
+	};
+
+	// Halfway between the crouched and the standing capsule top, then lets go of crouch
+	const auto PlaceObstacle = [Scenario]()
+	{
+		AFPCharacter* Character = Scenario->Character.Get();
+		if (!Character)
+			return;
+
+		const float HalfHeight = Scenario->GetHalfHeight();
+		const FVector Feet = Character->GetActorLocation() - FVector(0.0f, 0.0f, HalfHeight);
+		const FVector Extent(100.0f, 100.0f, 10.0f);
+		const FVector ObstacleLocation = Feet + FVector(0.0f, 0.0f, HalfHeight + GetStandingHalfHeight() + Extent.Z);
+
+		Scenario->Obstacle = SpawnBox(*Character->GetWorld(), ObstacleLocation, Extent);
+		Scenario->Character->SetCrouchIntent(false);
+	};
+
+	const auto RemoveObstacle = [Scenario]()
+	{
+		if (Scenario->Obstacle.IsValid())
+			Scenario->Obstacle->Destroy();
+	};
+
+	TArray<FFirstPersonScenarioStep> Steps;
+	Steps.Add(MakeStep(TEXT("landing after the spawn"), 1.0f, nullptr, INDEX_NONE));
+	Steps.Add(MakeStep(TEXT("standing"), 1.0f, nullptr, 0));
+	Steps.Add(MakeStep(TEXT("crouching"), 1.0f, SetCrouchIntent(true), 0));
+	Steps.Add(MakeStep(TEXT("standing up under an obstacle"), 1.0f, PlaceObstacle, MaxSweepsPerFrame));
+	Steps.Add(MakeStep(TEXT("standing up in the open"), 1.0f, RemoveObstacle, MaxSweepsPerFrame));
+	Steps.Add(MakeStep(TEXT("standing"), 1.0f, nullptr, 0));
+
+	// The budgets only mean something if the character really crouched and stood up
+	const float StandingHalfHeight = GetStandingHalfHeight();
+	Steps[2].End = [this, Scenario, StandingHalfHeight, End = Steps[2].End](const int32 NumFrames)
+	{
+		End(NumFrames);
+		TestTrue(TEXT("The character crouched"), Scenario->GetHalfHeight() < StandingHalfHeight - 1.0f);
+	};
+	Steps[3].End = [this, Scenario, StandingHalfHeight, End = Steps[3].End](const int32 NumFrames)
+	{
+		End(NumFrames);
+		TestTrue(TEXT("The obstacle kept the character from standing up"), Scenario->GetHalfHeight() < StandingHalfHeight - 1.0f);
+	};
+	Steps[4].End = [this, Scenario, StandingHalfHeight, End = Steps[4].End](const int32 NumFrames)
+	{
+		End(NumFrames);
+		TestEqual(TEXT("The character stood up"), Scenario->GetHalfHeight(), StandingHalfHeight, 1.0f);
+	};
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFirstPersonScenarioCommand(this, Setup, MoveTemp(Steps), Cleanup));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstPersonFootstepBudgetTest, "FirstPersonCharacter.Budget.FootstepSceneQueries", EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FFirstPersonFootstepBudgetTest::RunTest(const FString& Parameters)
+{
+	using namespace FirstPersonBudget;
+	using namespace FirstPersonTest;
+
+	struct FScenario
+	{
+		FFootstepCourse Course;
+		int32 FootstepsAtStepBegin = 0;
+		int32 SweepsAtStepBegin = 0;
+		int32 LookupsAtStepBegin = 0;
+	};
+	const TSharedRef<FScenario> Scenario = MakeShared<FScenario>();
+
+	const auto Setup = [this, Scenario](UWorld& World)
+	{
+		return Scenario->Course.Spawn(*this, World);
+	};
+
+	const auto Cleanup = [Scenario]()
+	{
+		Scenario->Course.Destroy();
+	};
+
+	const auto MakeStep = [this, Scenario](const FString& Name, const float Duration, const FVector2D Move, const bool bRun, const bool bCheckBudgets)
+	{
+		FFirstPersonScenarioStep Step;
+		Step.Duration = Duration;
+		Step.Begin = [Scenario, bRun]()
+		{
+			if (AFPCharacter* Character = Scenario->Course.Character.Get())
+			{
+				Scenario->FootstepsAtStepBegin = FFirstPersonCharacterTestAccess::GetNumFootstepsRequested(*Character);
+				Scenario->SweepsAtStepBegin = FFirstPersonCharacterTestAccess::GetNumFootstepFloorSweeps(*Character);
+				Scenario->LookupsAtStepBegin = FFirstPersonCharacterTestAccess::GetNumFootstepMaterialLookups(*Character);
+				Character->SetRunIntent(bRun);
+			}
+		};
+		Step.Tick = [Scenario, Move]()
+		{
+			if (Scenario->Course.Character.IsValid() && !Move.IsZero())
+				Scenario->Course.Character->AddMoveIntent(Move);
+		};
+		Step.End = [this, Scenario, Name, bCheckBudgets](int32)
+		{
+			const AFPCharacter* Character = Scenario->Course.Character.Get();
+			if (!bCheckBudgets || !Character)
+				return;
+
+			const int32 NumFootsteps = FFirstPersonCharacterTestAccess::GetNumFootstepsRequested(*Character) - Scenario->FootstepsAtStepBegin;
+			const int32 NumSweeps = FFirstPersonCharacterTestAccess::GetNumFootstepFloorSweeps(*Character) - Scenario->SweepsAtStepBegin;
+			const int32 NumLookups = FFirstPersonCharacterTestAccess::GetNumFootstepMaterialLookups(*Character) - Scenario->LookupsAtStepBegin;
+
+			// Without footsteps on the mapped surface the budgets don't mean anything
+			TestTrue(FString::Printf(TEXT("Footsteps were played while %s"), *Name), NumFootsteps > 0);
+			TestTrue(FString::Printf(TEXT("The footsteps while %s used the floor's mapping"), *Name), FFirstPersonCharacterTestAccess::GetCurrentFootstepMapping(*Character) == Scenario->Course.Mapping.Get());
+
+			CheckBudget(*this, FString::Printf(TEXT("Floor sweeps for %d footsteps while %s"), NumFootsteps, *Name), NumSweeps, NumFootsteps * MaxFloorSweepsPerFootstep);
+			CheckBudget(*this, FString::Printf(TEXT("Floor material lookups for %d footsteps while %s"), NumFootsteps, *Name), NumLookups, MaxMaterialLookupsPerFloor);
+		};
+		return Step;
+	};
+
+	const FVector2D Forward(1.0f, 0.0f);
+	TArray<FFirstPersonScenarioStep> Steps;
+	Steps.Add(MakeStep(TEXT("landing after the spawn"), 1.0f, FVector2D::ZeroVector, false, false));
+	Steps.Add(MakeStep(TEXT("walking"), 2.0f, Forward, false, true));
+	Steps.Add(MakeStep(TEXT("running"), 2.0f, -Forward, true, true));
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFirstPersonScenarioCommand(this, Setup, MoveTemp(Steps), Cleanup));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstPersonAllocationBudgetTest, "FirstPersonCharacter.Budget.SteadyStateAllocations", EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FFirstPersonAllocationBudgetTest::RunTest(const FString& Parameters)
+{
+#if PLATFORM_USES_FIXED_GMalloc_CLASS
+	AddWarning(TEXT("GMalloc is fixed on this platform, allocations can't be counted"));
+	return true;
+#else
+	using namespace FirstPersonBudget;
+	using namespace FirstPersonTest;
+
+	struct FScenario
+	{
+		FFootstepCourse Course;
+		int32 NumAllocations = 0;
+	};
+	const TSharedRef<FScenario> Scenario = MakeShared<FScenario>();
+
+	const auto Setup = [this, Scenario](UWorld& World)
+	{
+		FCountingMalloc& CountingMalloc = FCountingMalloc::Get();
+		CountingMalloc.Install();
+
+		// Make sure the counter really sees the allocations of the game thread
+		CountingMalloc.Begin();
+		TArray<uint8> Allocation;
+		Allocation.Reserve(64);
+		if (!TestTrue(TEXT("The allocation counter works"), CountingMalloc.End() > 0))
+			return false;
+
+		return Scenario->Course.Spawn(*this, World);
+	};
+
+	const auto Cleanup = [Scenario]()
+	{
+		FCountingMalloc::Get().Uninstall();
+		Scenario->Course.Destroy();
+	};
+
+	// Runs the character's tick and a footstep on top of what the world does with it, counted or not
+	const auto Update = [Scenario](const bool bCount)
+	{
+		AFPCharacter* Character = Scenario->Course.Character.Get();
+		if (!Character)
+			return;
+
+		Character->AddMoveIntent(FVector2D(1.0f, 0.0f));
+
+		FCountingMalloc& CountingMalloc = FCountingMalloc::Get();
+		if (bCount)
+			CountingMalloc.Begin();
+
+		FFirstPersonCharacterTestAccess::Tick(*Character, Character->GetWorld()->GetDeltaSeconds());
+		FFirstPersonCharacterTestAccess::PlayFootstepSound(*Character);
+
+		if (bCount)
+			Scenario->NumAllocations += CountingMalloc.End();
+	};
+
+	TArray<FFirstPersonScenarioStep> Steps;
+
+	FFirstPersonScenarioStep& Landing = Steps.AddDefaulted_GetRef();
+	Landing.Duration = 1.0f;
+
+	// The first footsteps load sounds and fill the caches and queues
+	FFirstPersonScenarioStep& Warmup = Steps.AddDefaulted_GetRef();
+	Warmup.Duration = 1.0f;
+	Warmup.Tick = [Update]() { Update(false); };
+
+	// The audio engine allocates for every sound it starts, so this covers everything up to the footstep audio subsystem's queue
+	FFirstPersonScenarioStep& SteadyState = Steps.AddDefaulted_GetRef();
+	SteadyState.Duration = 1.0f;
+	SteadyState.Tick = [Update]() { Update(true); };
+	SteadyState.End = [this, Scenario](const int32 NumFrames)
+	{
+		CheckBudget(*this, FString::Printf(TEXT("Allocations of the character tick and footsteps over %d frames"), NumFrames), Scenario->NumAllocations, MaxSteadyStateAllocations);
+	};
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFirstPersonScenarioCommand(this, Setup, MoveTemp(Steps), Cleanup));
+	return true;
+#endif
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstPersonConfigWriteTest, "FirstPersonCharacter.Budget.InputConfigWrites", EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FFirstPersonConfigWriteTest::RunTest(const FString& Parameters)
+{
+	using namespace FirstPersonBudget;
+	using namespace FirstPersonTest;
+
+	struct FScenario
+	{
+		FConfigSnapshot ConfigSnapshot;
+		TWeakObjectPtr<AFPCharacter> Character;
+		TWeakObjectPtr<APlayerController> PlayerController;
+		TWeakObjectPtr<APawn> PreviousPawn;
+	};
+	const TSharedRef<FScenario> Scenario = MakeShared<FScenario>();
+
+	// The input profile applies its bindings when the character is possessed, nothing of it may end up in config
+	const auto Setup = [this, Scenario](UWorld& World)
+	{
+		APlayerController* PlayerController = World.GetFirstPlayerController();
+		if (!PlayerController)
+		{
+			AddError(TEXT("Input bindings are only applied for a local player, but there is none"));
+			return false;
+		}
+
+		Scenario->ConfigSnapshot.Take();
+
+		AFPCharacter* Character = BeginSpawnCharacter(World, GetTestLocation(World));
+		if (!Character)
+		{
+			AddError(TEXT("Couldn't spawn the character"));
+			return false;
+		}
+
+		Character->FinishSpawning(Character->GetActorTransform());
+
+		Scenario->Character = Character;
+		Scenario->PlayerController = PlayerController;
+		Scenario->PreviousPawn = PlayerController->GetPawn();
+
+		PlayerController->Possess(Character);
+		return true;
+	};
+
+	const auto Cleanup = [Scenario]()
+	{
+		if (Scenario->Character.IsValid())
+			Scenario->Character->Destroy();
+
+		if (Scenario->PlayerController.IsValid() && Scenario->PreviousPawn.IsValid())
+			Scenario->PlayerController->Possess(Scenario->PreviousPawn.Get());
+	};
+
+	TArray<FFirstPersonScenarioStep> Steps;
+
+	FFirstPersonScenarioStep& Possessed = Steps.AddDefaulted_GetRef();
+	Possessed.Duration = 0.5f;
+	Possessed.End = [this, Scenario](int32)
+	{
+		Scenario->ConfigSnapshot.CheckUnchanged(*this, TEXT("while the character began play and applied its bindings"));
+	};
+
+	FFirstPersonScenarioStep& Reset = Steps.AddDefaulted_GetRef();
+	Reset.Duration = 0.5f;
+	Reset.Begin = [Scenario]()
+	{
+		if (Scenario->Character.IsValid())
+			Scenario->Character->ResetToDefaultInputBindings();
+	};
+	Reset.End = [this, Scenario](int32)
+	{
+		Scenario->ConfigSnapshot.CheckUnchanged(*this, TEXT("by resetting to the default bindings"));
+	};
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFirstPersonScenarioCommand(this, Setup, MoveTemp(Steps), Cleanup));
+	return true;
+}
+
+#endif
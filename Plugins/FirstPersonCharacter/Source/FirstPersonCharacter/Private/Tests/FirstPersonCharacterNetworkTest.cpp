@@ -0,0 +1,297 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonCharacterMovementComponent.h"
+#include "FirstPersonCharacterTestAccess.h"
+#include "FirstPersonScenarioCommand.h"
+#include "FPCharacter.h"
+
+#include "Components/CapsuleComponent.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+#include "GameFramework/PlayerController.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+#include "Editor.h"
+#include "Settings/LevelEditorPlaySettings.h"
+#include "Tests/AutomationEditorCommon.h"
+
+namespace FirstPersonNetwork
+{
+	const int32 NumClients = 2;
+
+	// The server and the clients run in one process without lag or loss, a predicted transition shouldn't need more than one
+	const int32 MaxCorrectionsPerTransition = 1;
+
+	// Also the time the spawned characters have to reach the clients
+	const float SessionTimeout = 30.0f;
+
+	UWorld* GetServerWorld()
+	{
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			UWorld* World = Context.World();
+			if (Context.WorldType == EWorldType::PIE && World && World->GetNetMode() != NM_Client)
+				return World;
+		}
+
+		return nullptr;
+	}
+
+	void GetClientWorlds(TArray<UWorld*>& OutClientWorlds)
+	{
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			UWorld* World = Context.World();
+			if (Context.WorldType == EWorldType::PIE && World && World->GetNetMode() == NM_Client)
+				OutClientWorlds.Add(World);
+		}
+	}
+
+	APawn* GetClientPawn(UWorld& ClientWorld)
+	{
+		const APlayerController* PlayerController = ClientWorld.GetFirstPlayerController();
+		return PlayerController ? PlayerController->GetPawn() : nullptr;
+	}
+}
+
+// Waits until the play session has a server and all clients have a player controller
+class FWaitForFirstPersonNetSessionCommand : public IAutomationLatentCommand
+{
+public:
+	explicit FWaitForFirstPersonNetSessionCommand(FAutomationTestBase* InTest) : Test(InTest) {}
+
+	bool Update() override
+	{
+		using namespace FirstPersonNetwork;
+
+		TArray<UWorld*> ClientWorlds;
+		GetClientWorlds(ClientWorlds);
+
+		int32 NumReady = 0;
+		for (UWorld* ClientWorld : ClientWorlds)
+		{
+			if (ClientWorld->GetFirstPlayerController())
+				NumReady++;
+		}
+
+		if (GetServerWorld() && NumReady == NumClients)
+			return true;
+
+		if (GetCurrentRunTime() > SessionTimeout)
+		{
+			Test->AddError(FString::Printf(TEXT("Only %d of %d clients joined the play session"), NumReady, NumClients));
+			return true;
+		}
+
+		return false;
+	}
+
+private:
+	FAutomationTestBase* Test;
+};
+
+/**
+ * Plays the current map with a server and two clients in one process. Every client gets a character with predicted locomotion,
+ * runs and crouches through a scripted route, and the server's corrections of each transition are counted on the client
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstPersonCorrectionTest, "FirstPersonCharacter.Network.ClientCorrections", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FFirstPersonCorrectionTest::RunTest(const FString& Parameters)
+{
+	using namespace FirstPersonNetwork;
+	using namespace FirstPersonTest;
+
+	struct FClient
+	{
+		TWeakObjectPtr<AFPCharacter> ServerCharacter;
+		TWeakObjectPtr<APawn> PreviousServerPawn;
+		TWeakObjectPtr<APawn> PreviousClientPawn;
+		TWeakObjectPtr<UWorld> ClientWorld;
+		TWeakObjectPtr<AFPCharacter> Character;
+		int32 CorrectionsAtStepBegin = 0;
+
+		int32 GetNumCorrections() const
+		{
+			const UFirstPersonCharacterMovementComponent* Movement = Character.IsValid() ? Cast<UFirstPersonCharacterMovementComponent>(Character->GetCharacterMovement()) : nullptr;
+			return Movement ? Movement->GetNumClientCorrections() : 0;
+		}
+	};
+
+	struct FScenario
+	{
+		TArray<FClient> Clients;
+		FVector2D Move = FVector2D::ZeroVector;
+	};
+	const TSharedRef<FScenario> Scenario = MakeShared<FScenario>();
+
+	// Possess a new predicted character with every remote player controller on the server
+	const auto Setup = [this, Scenario](UWorld&)
+	{
+		UWorld* ServerWorld = GetServerWorld();
+		TArray<UWorld*> ClientWorlds;
+		GetClientWorlds(ClientWorlds);
+		if (!ServerWorld || ClientWorlds.Num() != NumClients)
+		{
+			AddError(TEXT("The play session has no server or is missing clients"));
+			return false;
+		}
+
+		// Clients tell their new character apart from the pawn they had before
+		for (UWorld* ClientWorld : ClientWorlds)
+		{
+			FClient& Client = Scenario->Clients.AddDefaulted_GetRef();
+			Client.ClientWorld = ClientWorld;
+			Client.PreviousClientPawn = GetClientPawn(*ClientWorld);
+		}
+
+		const FVector Location = GetTestLocation(*ServerWorld);
+		int32 NumSpawned = 0;
+		for (FConstPlayerControllerIterator It = ServerWorld->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* PlayerController = It->Get();
+			if (!PlayerController || PlayerController->IsLocalController() || !Scenario->Clients.IsValidIndex(NumSpawned))
+				continue;
+
+			// Side by side, so they don't push each other around
+			AFPCharacter* Character = BeginSpawnCharacter(*ServerWorld, Location + FVector(0.0f, 200.0f * NumSpawned, 0.0f));
+			if (!Character)
+				continue;
+
+			FFirstPersonCharacterTestAccess::SetPredictLocomotion(*Character, true);
+			Character->FinishSpawning(Character->GetActorTransform());
+
+			FClient& Client = Scenario->Clients[NumSpawned++];
+			Client.ServerCharacter = Character;
+			Client.PreviousServerPawn = PlayerController->GetPawn();
+			PlayerController->Possess(Character);
+		}
+
+		if (NumSpawned != NumClients)
+		{
+			AddError(FString::Printf(TEXT("Spawned characters for %d of %d clients"), NumSpawned, NumClients));
+			return false;
+		}
+
+		return true;
+	};
+
+	const auto Cleanup = [Scenario]()
+	{
+		for (const FClient& Client : Scenario->Clients)
+		{
+			if (!Client.ServerCharacter.IsValid())
+				continue;
+
+			AController* Controller = Client.ServerCharacter->GetController();
+			if (Controller && Client.PreviousServerPawn.IsValid())
+				Controller->Possess(Client.PreviousServerPawn.Get());
+
+			Client.ServerCharacter->Destroy();
+		}
+	};
+
+	// The settings don't replicate, so the clients' copies have to predict too
+	FFirstPersonScenarioStep WaitForCharacters;
+	WaitForCharacters.Duration = 2.0f;
+	WaitForCharacters.Tick = [Scenario]()
+	{
+		for (FClient& Client : Scenario->Clients)
+		{
+			if (Client.Character.IsValid() || !Client.ClientWorld.IsValid())
+				continue;
+
+			APawn* Pawn = GetClientPawn(*Client.ClientWorld);
+			AFPCharacter* Character = Cast<AFPCharacter>(Pawn);
+			if (Character && Pawn != Client.PreviousClientPawn.Get() && Character->GetLocalRole() == ROLE_AutonomousProxy)
+			{
+				FFirstPersonCharacterTestAccess::SetPredictLocomotion(*Character, true);
+				Client.Character = Character;
+			}
+		}
+	};
+	WaitForCharacters.End = [this, Scenario](int32)
+	{
+		for (const FClient& Client : Scenario->Clients)
+			TestTrue(TEXT("The character reached its client"), Client.Character.IsValid());
+	};
+
+	const auto MakeStep = [this, Scenario](const FString& Name, const float Duration, const FVector2D Move, const bool bRun, const bool bCrouch)
+	{
+		FFirstPersonScenarioStep Step;
+		Step.Duration = Duration;
+		Step.Begin = [Scenario, Move, bRun, bCrouch]()
+		{
+			Scenario->Move = Move;
+
+			for (FClient& Client : Scenario->Clients)
+			{
+				Client.CorrectionsAtStepBegin = Client.GetNumCorrections();
+
+				if (AFPCharacter* Character = Client.Character.Get())
+				{
+					Character->SetRunIntent(bRun);
+					Character->SetCrouchIntent(bCrouch);
+				}
+			}
+		};
+		Step.Tick = [Scenario]()
+		{
+			for (const FClient& Client : Scenario->Clients)
+			{
+				if (Client.Character.IsValid() && !Scenario->Move.IsZero())
+					Client.Character->AddMoveIntent(Scenario->Move);
+			}
+		};
+		Step.End = [this, Scenario, Name](int32)
+		{
+			for (int32 i = 0; i < Scenario->Clients.Num(); i++)
+			{
+				const FClient& Client = Scenario->Clients[i];
+				CheckBudget(*this, FString::Printf(TEXT("Client %d corrections while %s"), i, *Name), Client.GetNumCorrections() - Client.CorrectionsAtStepBegin, MaxCorrectionsPerTransition);
+			}
+		};
+		return Step;
+	};
+
+	// Back and forth, so the characters stay near the player start
+	const FVector2D Forward(1.0f, 0.0f);
+	TArray<FFirstPersonScenarioStep> Steps;
+	Steps.Add(WaitForCharacters);
+	Steps.Add(MakeStep(TEXT("starting to walk"), 1.0f, Forward, false, false));
+	Steps.Add(MakeStep(TEXT("starting to run"), 1.0f, -Forward, true, false));
+	Steps.Add(MakeStep(TEXT("crouching while running"), 1.0f, Forward, true, true));
+	Steps.Add(MakeStep(TEXT("standing up while running"), 1.0f, -Forward, true, false));
+	Steps.Add(MakeStep(TEXT("crouching in place"), 1.0f, FVector2D::ZeroVector, false, true));
+	Steps.Add(MakeStep(TEXT("standing up in place"), 1.0f, FVector2D::ZeroVector, false, false));
+
+	// The budgets only mean something if the clients really crouched
+	const float StandingHalfHeight = GetDefault<AFPCharacter>()->GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight();
+	Steps[3].End = [this, Scenario, StandingHalfHeight, End = Steps[3].End](const int32 NumFrames)
+	{
+		End(NumFrames);
+		for (const FClient& Client : Scenario->Clients)
+			TestTrue(TEXT("The client crouched"), Client.Character.IsValid() && Client.Character->GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight() < StandingHalfHeight - 1.0f);
+	};
+
+	ULevelEditorPlaySettings* PlaySettings = NewObject<ULevelEditorPlaySettings>();
+	PlaySettings->SetPlayNetMode(EPlayNetMode::PIE_Client);
+	PlaySettings->SetPlayNumberOfClients(NumClients);
+	PlaySettings->SetRunUnderOneProcess(true);
+
+	FRequestPlaySessionParams SessionParams;
+	SessionParams.WorldType = EPlaySessionWorldType::PlayInEditor;
+	SessionParams.EditorPlaySettings = PlaySettings;
+	GEditor->RequestPlaySession(SessionParams);
+
+	ADD_LATENT_AUTOMATION_COMMAND(FWaitForFirstPersonNetSessionCommand(this));
+	ADD_LATENT_AUTOMATION_COMMAND(FFirstPersonScenarioCommand(this, Setup, MoveTemp(Steps), Cleanup));
+	ADD_LATENT_AUTOMATION_COMMAND(FEndPlayMapCommand());
+	return true;
+}
+
+#endif
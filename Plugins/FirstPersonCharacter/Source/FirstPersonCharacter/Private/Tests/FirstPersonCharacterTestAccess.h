@@ -0,0 +1,58 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "FPCharacter.h"
+#include "FirstPersonFootstepData.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Lets the automation tests change the protected settings of a character, usually before it begins play, and read its counters
+struct FFirstPersonCharacterTestAccess
+{
+	static void SetPredictLocomotion(AFPCharacter& Character, const bool bPredict)
+	{
+		Character.Movement.bPredictLocomotion = bPredict;
+	}
+
+	static void SetCameraShakes(AFPCharacter& Character, const FCameraShakes& Shakes)
+	{
+		Character.CameraShakes = Shakes;
+	}
+
+	static void SetFootstepMappings(AFPCharacter& Character, const TArray<UFirstPersonFootstepData*>& Mappings)
+	{
+		Character.FootstepSettings.Mappings = Mappings;
+	}
+
+	// A transient mapping with a single sound
+	static UFirstPersonFootstepData* NewFootstepData(UPhysicalMaterial* Surface, USoundBase* Sound)
+	{
+		UFirstPersonFootstepData* Mapping = NewObject<UFirstPersonFootstepData>(GetTransientPackage());
+		Mapping->PhysicalMaterial = Surface;
+		Mapping->Sounds.Add(Sound);
+		return Mapping;
+	}
+
+	static const UFirstPersonFootstepData* GetCurrentFootstepMapping(const AFPCharacter& Character)
+	{
+		return Character.CurrentFootstepMapping;
+	}
+
+	static int32 GetNumFootstepsRequested(const AFPCharacter& Character) { return Character.NumFootstepsRequested; }
+	static int32 GetNumFootstepFloorSweeps(const AFPCharacter& Character) { return Character.NumFootstepFloorSweeps; }
+	static int32 GetNumFootstepMaterialLookups(const AFPCharacter& Character) { return Character.NumFootstepMaterialLookups; }
+
+	// Runs the character's own update outside of the world tick, e.g. to measure it
+	static void Tick(AFPCharacter& Character, const float DeltaTime)
+	{
+		Character.Tick(DeltaTime);
+	}
+
+	static void PlayFootstepSound(AFPCharacter& Character)
+	{
+		Character.PlayFootstepSound();
+	}
+};
+
+#endif
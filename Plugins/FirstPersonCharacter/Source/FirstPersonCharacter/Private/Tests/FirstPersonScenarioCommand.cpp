@@ -0,0 +1,117 @@
+// Copyright Ali El Saleh, 2020
+
+#include "FirstPersonScenarioCommand.h"
+#include "FPCharacter.h"
+
+#include "Components/BoxComponent.h"
+
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+#include "GameFramework/PlayerStart.h"
+
+#include "Tests/AutomationCommon.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+void FirstPersonTest::CheckBudget(FAutomationTestBase& Test, const FString& What, const int32 Count, const int32 Budget)
+{
+	if (Count > Budget)
+		Test.AddError(FString::Printf(TEXT("%s: %d, the budget is %d"), *What, Count, Budget));
+}
+
+FVector FirstPersonTest::GetTestLocation(UWorld& World)
+{
+	for (TActorIterator<APlayerStart> It(&World); It; ++It)
+		return It->GetActorLocation();
+
+	return FVector::ZeroVector;
+}
+
+AFPCharacter* FirstPersonTest::BeginSpawnCharacter(UWorld& World, const FVector& Location)
+{
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.bDeferConstruction = true;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	AFPCharacter* Character = World.SpawnActor<AFPCharacter>(Location, FRotator::ZeroRotator, SpawnParameters);
+	if (Character)
+	{
+		Character->AutoPossessPlayer = EAutoReceiveInput::Disabled;
+		Character->AutoReceiveInput = EAutoReceiveInput::Disabled;
+	}
+
+	return Character;
+}
+
+AActor* FirstPersonTest::SpawnBox(UWorld& World, const FVector& Location, const FVector& Extent)
+{
+	AActor* Box = World.SpawnActor<AActor>(AActor::StaticClass(), FTransform(Location));
+	if (!Box)
+		return nullptr;
+
+	UBoxComponent* BoxComponent = NewObject<UBoxComponent>(Box, FName("Box"));
+	BoxComponent->SetBoxExtent(Extent);
+	BoxComponent->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	Box->SetRootComponent(BoxComponent);
+	BoxComponent->RegisterComponent();
+	BoxComponent->SetWorldLocation(Location);
+
+	return Box;
+}
+
+bool FFirstPersonScenarioCommand::Update()
+{
+	UWorld* World = AutomationCommon::GetAnyGameWorld();
+	if (!World)
+	{
+		Test->AddError(TEXT("The scenario needs a game world, run it with -game or in PIE"));
+		return true;
+	}
+
+	if (StepIndex == INDEX_NONE)
+	{
+		if (!Setup(*World) || Steps.Num() == 0)
+		{
+			Cleanup();
+			return true;
+		}
+
+		BeginStep(0);
+		return false;
+	}
+
+	const FFirstPersonScenarioStep& Step = Steps[StepIndex];
+	if (Step.Tick)
+		Step.Tick();
+
+	StepTime += World->GetDeltaSeconds();
+	StepFrames++;
+	if (StepTime < Step.Duration)
+		return false;
+
+	if (Step.End)
+		Step.End(StepFrames);
+
+	if (StepIndex == Steps.Num() - 1)
+	{
+		Cleanup();
+		return true;
+	}
+
+	BeginStep(StepIndex + 1);
+	return false;
+}
+
+void FFirstPersonScenarioCommand::BeginStep(const int32 NewStepIndex)
+{
+	StepIndex = NewStepIndex;
+	StepTime = 0.0f;
+	StepFrames = 0;
+
+	if (Steps[StepIndex].Begin)
+		Steps[StepIndex].Begin();
+}
+
+#endif
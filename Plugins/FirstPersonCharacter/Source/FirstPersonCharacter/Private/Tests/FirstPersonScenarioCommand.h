@@ -0,0 +1,66 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+class AFPCharacter;
+
+namespace FirstPersonTest
+{
+	// Adds an error when Count is over Budget
+	void CheckBudget(FAutomationTestBase& Test, const FString& What, int32 Count, int32 Budget);
+
+	// The first player start, or the origin when there is none
+	FVector GetTestLocation(UWorld& World);
+
+	// Deferred and without auto possession, so the caller can change the settings before the character begins play
+	AFPCharacter* BeginSpawnCharacter(UWorld& World, const FVector& Location);
+
+	// A blocking box of the given half size, e.g. a floor or an obstacle
+	AActor* SpawnBox(UWorld& World, const FVector& Location, const FVector& Extent);
+}
+
+// One step of a scripted scenario. Begin and Tick drive the character, End checks the budgets of the step
+struct FFirstPersonScenarioStep
+{
+	float Duration = 1.0f;
+	TFunction<void()> Begin;
+	TFunction<void()> Tick;
+	TFunction<void(int32 NumFrames)> End;
+};
+
+/**
+ * Plays the steps of a scenario one after another in the running game world, ticking the current step once per frame.
+ * Setup runs on the first frame and returns false when the scenario can't run. Cleanup runs when the scenario is over, also after a failed setup
+ */
+class FFirstPersonScenarioCommand : public IAutomationLatentCommand
+{
+public:
+	FFirstPersonScenarioCommand(FAutomationTestBase* InTest, TFunction<bool(UWorld&)> InSetup, TArray<FFirstPersonScenarioStep> InSteps, TFunction<void()> InCleanup)
+		: Test(InTest)
+		, Setup(MoveTemp(InSetup))
+		, Steps(MoveTemp(InSteps))
+		, Cleanup(MoveTemp(InCleanup))
+	{
+	}
+
+	bool Update() override;
+
+private:
+	void BeginStep(int32 NewStepIndex);
+
+	FAutomationTestBase* Test;
+	TFunction<bool(UWorld&)> Setup;
+	TArray<FFirstPersonScenarioStep> Steps;
+	TFunction<void()> Cleanup;
+
+	int32 StepIndex = INDEX_NONE;
+	float StepTime = 0.0f;
+	int32 StepFrames = 0;
+};
+
+#endif
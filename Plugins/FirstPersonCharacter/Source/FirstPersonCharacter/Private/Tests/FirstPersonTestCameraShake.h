@@ -0,0 +1,21 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "GameplayCameras/Public/MatineeCameraShake.h"
+#include "FirstPersonTestCameraShake.generated.h"
+
+/**
+ * A camera shake that oscillates until it's stopped, for the automation tests. Any restart of it is a shake started too many
+ */
+UCLASS(Transient, NotBlueprintable, HideDropdown)
+class UFirstPersonTestCameraShake : public UMatineeCameraShake
+{
+	GENERATED_BODY()
+
+public:
+	UFirstPersonTestCameraShake()
+	{
+		OscillationDuration = -1.0f;
+	}
+};
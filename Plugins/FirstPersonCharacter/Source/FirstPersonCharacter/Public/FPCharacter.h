@@ -7,6 +7,11 @@
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/PlayerInput.h"
 
+#include "UObject/ObjectKey.h"
+
+#include "FirstPersonCameraShakeComponent.h"
+#include "FirstPersonFootstepTable.h"
+
 #include "FPCharacter.generated.h"
 
 UENUM()
@@ -24,6 +29,21 @@ enum class EPlayerActionType : uint8
 	Toggle
 };
 
+UENUM()
+enum class EFirstPersonSignificance : uint8
+{
+	High,	// Everything at full rate
+	Medium,	// Footsteps, with a lower tick rate
+	Low		// Movement only, at a low tick rate
+};
+
+UENUM()
+enum class EHeadBobMode : uint8
+{
+	CameraShake,
+	Procedural
+};
+
 USTRUCT()
 struct FCameraShakes
 {
@@ -39,6 +59,33 @@ struct FCameraShakes
 		TSubclassOf<class UMatineeCameraShake> JumpShake;
 };
 
+USTRUCT()
+struct FHeadBobSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditInstanceOnly, Category = "Head Bob", meta = (ToolTip = "CameraShake plays the Idle/Walk/Run camera shakes. Procedural offsets the camera directly, without creating any shake instances"))
+		EHeadBobMode Mode = EHeadBobMode::CameraShake;
+
+	UPROPERTY(EditInstanceOnly, Category = "Head Bob", meta = (EditCondition = "Mode == EHeadBobMode::Procedural", ClampMin=1.0f, ToolTip = "How far the character has to travel for one full bob cycle (two footsteps)"))
+		float CycleDistance = 320.0f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Head Bob", meta = (EditCondition = "Mode == EHeadBobMode::Procedural", ClampMin=0.0f, ToolTip = "The vertical bob offset at walking speed"))
+		float VerticalAmplitude = 1.5f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Head Bob", meta = (EditCondition = "Mode == EHeadBobMode::Procedural", ClampMin=0.0f, ToolTip = "The sideways bob offset at walking speed"))
+		float LateralAmplitude = 0.75f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Head Bob", meta = (EditCondition = "Mode == EHeadBobMode::Procedural", ClampMin=0.0f, ToolTip = "The vertical breathing offset while idle"))
+		float BreathingAmplitude = 0.4f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Head Bob", meta = (EditCondition = "Mode == EHeadBobMode::Procedural", ClampMin=0.0f, ToolTip = "Breaths per second while idle"))
+		float BreathingRate = 0.25f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Head Bob", meta = (EditCondition = "Mode == EHeadBobMode::Procedural", ClampMin=0.0f, ToolTip = "How fast the bob blends in and out when starting or stopping"))
+		float BlendSpeed = 6.0f;
+};
+
 USTRUCT()
 struct FFootstepSettings
 {
@@ -50,6 +97,15 @@ struct FFootstepSettings
 	UPROPERTY(EditInstanceOnly, Category = "Footstep", meta = (EditCondition = "bEnableFootsteps", ToolTip = "An array of footstep data assets to play depending on the material the character is moving on"))
 		TArray<class UFirstPersonFootstepData*> Mappings;
 
+	UPROPERTY(EditInstanceOnly, Category = "Footstep", meta = (EditCondition = "bEnableFootsteps", ToolTip = "A bank cooked from all footstep data assets by the FirstPersonFootstepBank commandlet. When set, it's used instead of the mappings above"))
+		class UFirstPersonFootstepBank* Bank;
+
+	UPROPERTY(EditInstanceOnly, Category = "Footstep", meta = (EditCondition = "bEnableFootsteps", ToolTip = "Plays while the sounds of a surface are still loading. The sounds of the surfaces in the level's baked surface maps are loaded up front, any other surface is loaded the first time it's stepped on"))
+		USoundBase* FallbackSound;
+
+	UPROPERTY(EditInstanceOnly, Category = "Footstep", meta = (EditCondition = "bEnableFootsteps", ClampMin=0.0f, ClampMax=1.0f, ToolTip = "The volume of footsteps while crouching"))
+		float CrouchVolumeMultiplier = 0.35f;
+
 	float CurrentStride = 160.0f;
 };
 
@@ -73,6 +129,12 @@ struct FFirstPersonMovementSettings
 	UPROPERTY(EditInstanceOnly, Category = "Movement", meta = (ClampMin=1.0f, ClampMax=1000.0f, ToolTip = "How long does it take to enter the crouch stance?"))
 		float StandToCrouchTransitionSpeed = 10.0f;
 
+	UPROPERTY(EditInstanceOnly, Category = "Movement", meta = (ClampMin=0.0f, ClampMax=50.0f, ToolTip = "While crouching or standing up, the capsule is only resized in steps of this height. The camera still moves smoothly. 0 resizes the capsule every frame"))
+		float CrouchCapsuleHeightStep = 4.0f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Movement", meta = (ToolTip = "Step crouching and running inside the character movement, so clients predict them and agree with the server. Both sides must agree on whether a held crouch can be released, so every move then sweeps synchronously while it is, instead of using the async clearance answers. Predicted characters step in their moves, so the batched update is ignored for them"))
+		bool bPredictLocomotion = false;
+
 	UPROPERTY(EditInstanceOnly, Category = "Movement", meta = (ClampMin=0.0f, ClampMax=2.0f))
 	float BlockTestOffset{ 0.0f };
 
@@ -80,6 +142,27 @@ struct FFirstPersonMovementSettings
 	EPlayerActionType CrouchActionType{ EPlayerActionType::Hold };
 };
 
+USTRUCT()
+struct FFirstPersonSignificanceSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditInstanceOnly, Category = "Significance", meta = (ToolTip = "Lower the tick rate and skip cosmetic work for characters that are far away or out of view. Locally controlled characters always update at full rate"))
+		bool bEnableSignificance = false;
+
+	UPROPERTY(EditInstanceOnly, Category = "Significance", meta = (EditCondition = "bEnableSignificance", ClampMin=0.0f, ToolTip = "Visible characters closer than this to a local player's camera update at full rate"))
+		float HighSignificanceDistance = 2000.0f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Significance", meta = (EditCondition = "bEnableSignificance", ClampMin=0.0f, ToolTip = "Characters closer than this still play footsteps, at a lower tick rate. Anything further away only moves"))
+		float MediumSignificanceDistance = 6000.0f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Significance", meta = (EditCondition = "bEnableSignificance", ClampMin=0.0f, ClampMax=1.0f))
+		float MediumTickInterval = 0.1f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Significance", meta = (EditCondition = "bEnableSignificance", ClampMin=0.0f, ClampMax=2.0f))
+		float LowTickInterval = 0.5f;
+};
+
 USTRUCT()
 struct FFirstPersonCameraSettings
 {
@@ -96,6 +179,37 @@ struct FFirstPersonCameraSettings
 	
 	UPROPERTY(EditInstanceOnly, Category = "Camera", meta = (ClampMin="-360.0", ClampMax=360.0f, ToolTip = "The maximum view pitch, in degrees. Some examples are 20.0, 45.0, 90.0 or 0.0"))
         float MaxPitch = 90.0f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Camera", meta = (ToolTip = "Keep the camera on the zero-length spring arm. Disable this to attach the camera straight to the capsule and remove the spring arm when play begins, which saves its update every frame"))
+		bool bUseSpringArm = true;
+};
+
+// The part of the crouch and walk speed state that changes every frame
+struct FFirstPersonLocomotionState
+{
+	ECrouchPhase CrouchPhase = ECrouchPhase::Standing;
+	float CurrentWalkSpeed = 0.0f;
+	float MaxWalkSpeed = 0.0f;
+	float CrouchHalfHeight = 0.0f;
+	FVector CameraLocation = FVector::ZeroVector;
+};
+
+struct FFirstPersonLocomotionParams
+{
+	float WalkSpeed = 0.0f;
+	float RunSpeed = 0.0f;
+	float CrouchSpeed = 0.0f;
+	float TransitionSpeed = 0.0f;
+	float StandingHalfHeight = 0.0f;
+	FVector StandingCameraLocation = FVector::ZeroVector;
+};
+
+// Physical material of a floor component face, resolved during a previous footstep
+struct FFloorSurfaceCacheEntry
+{
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+	int32 FaceIndex = INDEX_NONE;
+	TWeakObjectPtr<const UPhysicalMaterial> Surface;
 };
 
 UCLASS()
@@ -103,21 +217,59 @@ class FIRSTPERSONCHARACTER_API AFPCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
+	friend class UFirstPersonCharacterSubsystem;
+	friend class UFirstPersonCharacterMovementComponent;
+	friend class FSavedMove_FirstPerson;
+	friend class UFirstPersonInputRecorderComponent;
+	friend class AFirstPersonBotSpawner;
+	friend struct FFirstPersonCharacterTestAccess;
+
 public:
-	AFPCharacter();
+	AFPCharacter(const FObjectInitializer& ObjectInitializer);
+
+	// Controller-agnostic intents. The input bindings of players and AI controllers like AFirstPersonBotController go through these
+
+	// X moves forward, Y moves right, relative to the control rotation
+	UFUNCTION(BlueprintCallable, Category = "First Person|Intent")
+		void AddMoveIntent(FVector2D Move);
+
+	// Turns the control rotation by X degrees of yaw and Y degrees of pitch, within the pitch limits of the camera settings
+	UFUNCTION(BlueprintCallable, Category = "First Person|Intent")
+		void AddLookIntent(FVector2D LookDelta);
+
+	UFUNCTION(BlueprintCallable, Category = "First Person|Intent")
+		void SetRunIntent(bool bRun);
+
+	// Returns false if there's no room to stand up with the toggle crouch action
+	UFUNCTION(BlueprintCallable, Category = "First Person|Intent")
+		bool SetCrouchIntent(bool bCrouch);
+
+	UFUNCTION(BlueprintCallable, Category = "First Person|Intent")
+		void SetJumpIntent(bool bJump);
+
+	UFUNCTION(BlueprintPure, Category = "First Person|Intent")
+		bool GetRunIntent() const { return bWantsToRun; }
+
+	UFUNCTION(BlueprintPure, Category = "First Person|Intent")
+		bool GetCrouchIntent() const { return bWantsToCrouch; }
+
+	// Drops this player's custom key mappings in favour of the defaults, e.g. from a settings menu. Nothing is written to config
+	UFUNCTION(BlueprintCallable, Category = "First Person|Input")
+		void ResetToDefaultInputBindings();
 
 protected:
 	void BeginPlay() override;
 	void Tick(float DeltaTime) override;
 	void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 	void Jump() override;
+	void StopJumping() override;
 	void Landed(const FHitResult& Hit) override;
 	void PossessedBy(AController* NewController) override;
+	void NotifyControllerChanged() override;
+	void OnMovementModeChanged(EMovementMode PrevMovementMode, uint8 PreviousCustomMode = 0) override;
 	void StartCrouch();
 	void StopCrouching();
 	void SetupInputBindings();
-	void ResetInputBindings();
-	void ResetToDefaultInputBindings();
 
 	void AddControllerYawInput(float Value) override;
 	void AddControllerPitchInput(float Value) override;
@@ -127,14 +279,56 @@ protected:
 
 	virtual void Quit();
 
-	void PlayFootstepSound();
-	USoundBase* GetFootstepSound(TWeakObjectPtr<UPhysicalMaterial>* Surface);
+	UFUNCTION()
+		void OnMovementUpdated(float DeltaSeconds, FVector OldLocation, FVector OldVelocity);
+
+	void UpdateFootstepStride(float DeltaSeconds, const FVector& OldLocation);
+	bool HasCosmetics() const;
+	bool ShouldPlayFootsteps() const;
+	bool IsRunning() const;
 
-	void UpdateWalkingSpeed();
+	void PlayFootstepSound(const FHitResult* FloorHit = nullptr);
+	bool FindBakedFootstepSurface(FVector& OutLocation, const UPhysicalMaterial*& OutSurface) const;
+	const FHitResult* FindFootstepFloor();
+	const UPhysicalMaterial* GetFloorSurface(const FHitResult& FloorHit);
+	USoundBase* GetFootstepSound(const UPhysicalMaterial* Surface);
+	void LoadLevelFootstepSounds();
+	void LoadFootstepSounds(int32 Entry);
 
-	void UpdateCrouch(float DeltaTime);
-	bool IsBlockedInCrouchStance();
+	void EndPlay(EEndPlayReason::Type EndPlayReason) override;
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UFUNCTION()
+		void OnRep_WantsToCrouch();
+
+	void UpdateLocomotion(float DeltaTime);
+	static void StepLocomotion(FFirstPersonLocomotionState& State, bool bCrouchIntent, bool bRunIntent, bool bStandUpBlocked, const FFirstPersonLocomotionParams& Params, float DeltaTime);
+	FFirstPersonLocomotionState CaptureLocomotion() const;
+	FFirstPersonLocomotionParams GetLocomotionParams() const;
+	// Only checks for room while a held crouch is being released, false otherwise and on simulated proxies
+	bool IsStandUpBlocked(bool bAllowCachedResult = true);
+	// bForce also restores the capsule when no transition is running, e.g. when replaying a saved move
+	void ApplyLocomotion(const FFirstPersonLocomotionState& State, bool bForce = false);
+
+	// Predicted locomotion is stepped by the movement component with each move, instead of by the tick
+	bool IsLocomotionPredicted() const;
+	void UpdatePredictedLocomotion(float DeltaSeconds);
+
+	// Locomotion only updates while something is changing. Input and movement events wake it up, and it goes back to rest once it has settled
+	void WakeLocomotion();
+	// Returns true if locomotion went to rest
+	bool TryRestLocomotion();
+	bool IsLocomotionSettled() const;
+
+	// bAllowCachedResult answers from last frame's async sweep instead of sweeping right away
+	bool IsBlockedInCrouchStance(bool bAllowCachedResult = false);
+	void SetCrouchHalfHeight(float NewHalfHeight, bool bExact);
 	void UpdateCameraShake();
+	bool UsesLocomotionShakes() const;
+	void UpdateHeadBobRegistration();
+	ELocomotionState GetLocomotionState() const;
+	void SetSignificance(EFirstPersonSignificance NewSignificance);
+	void ApplyCameraLocation();
 
 	UFUNCTION()
 		virtual void Interact();
@@ -143,13 +337,22 @@ protected:
 	UFUNCTION()
 		void StopRunning();
 
+	// The camera components are destroyed at BeginPlay on dedicated servers, and not created at all in server-only builds.
+	// Subclasses can skip them with ObjectInitializer.DoNotCreateDefaultSubobject
 	UPROPERTY(VisibleDefaultsOnly, Category = "Components")
         class USpringArmComponent* SpringArmComponent;
 	
 	UPROPERTY(VisibleDefaultsOnly, Category = "Components")
 		class UCameraComponent* CameraComponent;
+
+	UPROPERTY(VisibleDefaultsOnly, Category = "Components")
+		class UFirstPersonCameraShakeComponent* CameraShakeComponent;
+
+	// Only created for -FPRecord and -FPReplay runs, or added in a Blueprint
+	UPROPERTY(Transient)
+		class UFirstPersonInputRecorderComponent* InputRecorder;
 	
-	UPROPERTY(EditInstanceOnly, Category = "First Person Settings", meta = (ToolTip = "Enable this setting if you want to change the keys for specific action or axis mappings. Go to Project Settings -> Engine -> Input to update your inputs."))
+	UPROPERTY(EditInstanceOnly, Category = "First Person Settings", meta = (ToolTip = "Enable this setting if you want to change the keys for specific action or axis mappings. Go to Project Settings -> Engine -> Input to update your inputs. Actions and axes without any mapping there still get the default keys."))
 		bool bUseCustomKeyMappings = false;
 
 	UPROPERTY(EditAnywhere, Category = "First Person Settings", meta = (ToolTip = "Adjust these camera settings to your liking"))
@@ -164,7 +367,14 @@ protected:
 	UPROPERTY(EditAnywhere, Category = "First Person Settings", meta = (ToolTip = "Add one of your custom camera shakes to the corresponding slot"))
 		FCameraShakes CameraShakes;
 
-	class UInputSettings* Input{};
+	UPROPERTY(EditAnywhere, Category = "First Person Settings", meta = (ToolTip = "Choose between the camera shakes above and a procedural head bob"))
+		FHeadBobSettings HeadBob;
+
+	UPROPERTY(EditAnywhere, Category = "First Person Settings", meta = (ToolTip = "Scale this character's update rate with its distance and visibility to the local players"))
+		FFirstPersonSignificanceSettings Significance;
+
+	UPROPERTY(EditInstanceOnly, Category = "First Person Settings", meta = (ToolTip = "Disable this character's tick and update its crouch, walk speed and camera shakes together with all other batched characters. Useful with many characters. Note that the Blueprint Tick event won't fire. Ignored when Movement's Predict Locomotion is enabled"))
+		bool bUseBatchedUpdate = false;
 
 private:
 	APlayerController* PlayerController;
@@ -173,22 +383,51 @@ private:
 	
 	// Footstep variables
 	FVector LastFootstepLocation;
-	FVector LastLocation;
 	FFindFloorResult FloorResult;
+	FFloorSurfaceCacheEntry FloorSurfaceCache[4];
+	int32 NextFloorSurfaceCacheEntry = 0;
 	float TravelDistance = 0.0f;
+	FFirstPersonFootstepTable FootstepTable;
+	FRandomStream FootstepRandom;
+	FDelegateHandle SurfaceMapsChangedHandle;
+
+	// Surfaces we've already warned about having no footstep mapping
+	TSet<FObjectKey> UnmappedFootstepSurfaces;
+
+	// Footsteps and the scene queries they took, for the budget tests
+	int32 NumFootstepsRequested = 0;
+	int32 NumFootstepFloorSweeps = 0;
+	int32 NumFootstepMaterialLookups = 0;
 
 	// Crouching
 	float OriginalCapsuleHalfHeight{};
+	float CrouchHalfHeight{}; // Unquantized, the capsule follows it in steps
 	FVector OriginalCameraLocation; // Relative
+	FVector CameraBaseLocation; // Relative, without head bob
+
+	// Head bob
+	FVector HeadBobOffset;
+	int32 HeadBobHandle = INDEX_NONE;
+
+	// The subsystem keeps the locomotion state of batched characters, the members below are what the components currently show
+	int32 BatchedUpdateHandle = INDEX_NONE;
+
+	// Significance
+	EFirstPersonSignificance CurrentSignificance = EFirstPersonSignificance::High;
+	float SignificanceTickInterval = 0.0f;
+
+	// Locomotion state machine
+	bool bLocomotionAwake = true;
+	bool bCanRest{}; // False when a Blueprint needs the Tick event
+	FTimerHandle ShakeRestartTimerHandle;
 
 	ECrouchPhase CrouchPhase;
-	bool bWantsToCrouch{};
 	bool bWantsToRun{};
 
+	// Replicated to simulated proxies so they can follow the stance on their own
+	UPROPERTY(ReplicatedUsing = OnRep_WantsToCrouch)
+		bool bWantsToCrouch = false;
+
 	// Walking/Sprinting
 	float CurrentWalkSpeed;
-
-	// Input
-	TArray<FInputActionKeyMapping> ActionMappings;
-	TArray<FInputAxisKeyMapping> AxisMappings;
 };
@@ -0,0 +1,70 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "AIController.h"
+#include "FirstPersonBotController.generated.h"
+
+/**
+ * Drives a first person character through its intent API like a player would, for load tests.
+ * Wanders in a random direction for a while, then picks a new one, sometimes running, crouching or jumping on the way.
+ * Can also crouch on a fixed schedule, so load tests always have crouch transitions going on.
+ * Turns around when it gets stuck. No navigation, so it works in any map
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API AFirstPersonBotController : public AAIController
+{
+	GENERATED_BODY()
+
+public:
+	AFirstPersonBotController();
+
+	void Tick(float DeltaSeconds) override;
+
+	// Bots with the same seed make the same decisions
+	void SetRandomSeed(int32 Seed);
+
+	// Crouches for Duration once every Interval seconds, instead of by chance. An interval of 0 turns it off
+	void SetCrouchSchedule(float Interval, float Duration);
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.1f, ToolTip = "Shortest time between two decisions, in seconds"))
+		float MinDecisionTime = 2.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.1f, ToolTip = "Longest time between two decisions, in seconds"))
+		float MaxDecisionTime = 6.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.0f, ClampMax = 1.0f, ToolTip = "Chance to stand still instead of walking"))
+		float IdleChance = 0.1f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+		float RunChance = 0.3f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+		float CrouchChance = 0.15f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+		float JumpChance = 0.1f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.0f, ToolTip = "Crouch once every this many seconds, instead of by chance at decisions. 0 disables the schedule"))
+		float CrouchInterval = 0.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.0f, ToolTip = "How long each scheduled crouch is held, in seconds"))
+		float CrouchDuration = 1.5f;
+
+	UPROPERTY(EditAnywhere, Category = "Bot", meta = (ClampMin = 0.0f, ToolTip = "How fast the bot turns towards its new direction, in degrees per second"))
+		float TurnRate = 180.0f;
+
+protected:
+	void OnPossess(APawn* InPawn) override;
+
+private:
+	void Decide(class AFPCharacter* Bot);
+	void StaggerCrouchSchedule();
+
+	FRandomStream Random;
+	float TimeUntilDecision = 0.0f;
+	float CrouchScheduleTime = 0.0f;
+	float TimeStuck = 0.0f;
+	float WanderYaw = 0.0f;
+	bool bWandering = false;
+};
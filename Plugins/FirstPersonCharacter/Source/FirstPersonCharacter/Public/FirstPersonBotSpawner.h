@@ -0,0 +1,73 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "FirstPersonBotSpawner.generated.h"
+
+/**
+ * Fills the area around it with first person characters driven by bot controllers, to load test footsteps, crouching and camera shakes at scale.
+ * Bots are spawned a few per frame on the server, so starting a large test doesn't hitch
+ */
+UCLASS(HideCategories = (Rendering, Replication, Input, LOD, Cooking))
+class FIRSTPERSONCHARACTER_API AFirstPersonBotSpawner : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AFirstPersonBotSpawner();
+
+	void Tick(float DeltaSeconds) override;
+
+	UFUNCTION(BlueprintPure, Category = "Bots")
+		int32 GetNumBots() const { return Bots.Num(); }
+
+	UFUNCTION(BlueprintPure, Category = "Bots")
+		bool IsSpawning() const { return NumSpawnAttempts < NumBots; }
+
+	// Only has an effect before the spawner begins play, e.g. on a deferred spawn
+	void SetNumBots(const int32 NewNumBots) { NumBots = FMath::Max(NewNumBots, 0); }
+
+	// Only has an effect on bots spawned afterwards
+	void SetFootstepMappings(const TArray<class UFirstPersonFootstepData*>& NewFootstepMappings) { FootstepMappings = NewFootstepMappings; }
+
+	// Destroys the bots and their controllers
+	UFUNCTION(BlueprintCallable, Category = "Bots")
+		void DestroyBots();
+
+protected:
+	void BeginPlay() override;
+
+	UPROPERTY(EditAnywhere, Category = "Bots")
+		TSubclassOf<class AFPCharacter> BotClass;
+
+	UPROPERTY(EditAnywhere, Category = "Bots")
+		TSubclassOf<class AFirstPersonBotController> BotControllerClass;
+
+	UPROPERTY(EditAnywhere, Category = "Bots", meta = (ClampMin = 0))
+		int32 NumBots = 200;
+
+	UPROPERTY(EditAnywhere, Category = "Bots", meta = (ClampMin = 1, ToolTip = "How many bots to spawn per frame until all of them are in"))
+		int32 BotsPerFrame = 10;
+
+	UPROPERTY(EditAnywhere, Category = "Bots", meta = (ClampMin = 0.0f, ToolTip = "Bots are spawned at random locations within this distance of the spawner"))
+		float SpawnRadius = 5000.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Bots", meta = (ClampMin = 0.0f, ToolTip = "Bots stand on the floor found within this distance below the spawner, and aren't spawned where there is none"))
+		float FloorSearchDepth = 2000.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Bots", meta = (ToolTip = "The same seed spawns the bots at the same locations and makes them take the same decisions"))
+		int32 RandomSeed = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Bots", meta = (ToolTip = "When set, these replace the footstep mappings of the bot class, so its footsteps are load tested even if it has none"))
+		TArray<UFirstPersonFootstepData*> FootstepMappings;
+
+private:
+	void SpawnBot();
+
+	UPROPERTY(Transient)
+		TArray<AFPCharacter*> Bots;
+
+	FRandomStream Random;
+	int32 NumSpawnAttempts = 0;
+};
@@ -0,0 +1,78 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Components/ActorComponent.h"
+#include "FirstPersonCameraShakeComponent.generated.h"
+
+UENUM()
+enum class ELocomotionState : uint8
+{
+	Idle,
+	Walking,
+	Running,
+	Airborne
+};
+
+/**
+ * Plays the locomotion camera shakes of a first person character.
+ * Shakes are only started, stopped or blended when the locomotion state changes, and only on the owning client
+ */
+UCLASS(ClassGroup = "First Person", meta = (BlueprintSpawnableComponent))
+class FIRSTPERSONCHARACTER_API UFirstPersonCameraShakeComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFirstPersonCameraShakeComponent();
+
+	// Transitions to the given locomotion state. Does nothing if the state hasn't changed and the current shakes are still playing
+	void UpdateLocomotionState(ELocomotionState NewState, const struct FCameraShakes& Shakes);
+
+	// Plays a one-shot shake on top of the locomotion shakes (e.g. jumping or landing)
+	void PlayOneShot(TSubclassOf<class UCameraShakeBase> Shake, float Scale = 1.0f);
+
+	void StopLocomotionShakes(bool bImmediately);
+
+	ELocomotionState GetLocomotionState() const { return LocomotionState; }
+
+	// Time until the first locomotion shake runs out and needs a restart, MAX_flt if they all loop or their duration isn't known
+	float GetLocomotionShakeTimeRemaining() const;
+
+	// Locomotion and one-shot shakes started by this component
+	UFUNCTION(BlueprintPure, Category = "First Person|Camera Shake")
+		int32 GetNumShakesStarted() const { return NumShakesStarted; }
+
+protected:
+	void EndPlay(EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	class APlayerCameraManager* GetLocalCameraManager();
+
+	void StartLocomotionShakes(ELocomotionState State, const FCameraShakes& Shakes);
+	UCameraShakeBase* StartShake(TSubclassOf<class UCameraShakeBase> Shake, float Scale);
+	void StopShake(class UCameraShakeBase*& Shake, bool bImmediately);
+
+	static bool IsShakePlaying(const UCameraShakeBase* Shake);
+	float GetShakeTimeRemaining(const UCameraShakeBase* Shake, float StartTime) const;
+
+	UPROPERTY(Transient)
+		APlayerCameraManager* CameraManager;
+
+	// The idle or walk shake, depending on the current state
+	UPROPERTY(Transient)
+		UCameraShakeBase* BaseShake;
+
+	// Layered on top of the walk shake while running
+	UPROPERTY(Transient)
+		UCameraShakeBase* RunShake;
+
+	// World time the locomotion shakes were started at
+	float BaseShakeStartTime = 0.0f;
+	float RunShakeStartTime = 0.0f;
+
+	ELocomotionState LocomotionState;
+	bool bHasLocomotionState{};
+
+	int32 NumShakesStarted = 0;
+};
@@ -5,6 +5,13 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+FIRSTPERSONCHARACTER_API DECLARE_LOG_CATEGORY_EXTERN(LogFirstPersonCharacter, Log, All);
+
+// The camera, camera shakes, head bob and footstep audio. Compiled out of dedicated server builds, and skipped at runtime on dedicated servers
+#ifndef FIRSTPERSONCHARACTER_WITH_COSMETICS
+#define FIRSTPERSONCHARACTER_WITH_COSMETICS !UE_SERVER
+#endif
+
 class FFirstPersonCharacterModule : public IModuleInterface
 {
 public:
@@ -0,0 +1,32 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "GameFramework/CharacterMovementComponent.h"
+#include "FirstPersonCharacterMovementComponent.generated.h"
+
+/**
+ * Character movement that predicts the crouch and run transitions of a first person character.
+ * The run and crouch intents travel with each move in the compressed flags, and the capsule and walk speed are stepped inside the movement update on both the client and the server
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	class FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+	// Corrections this client received from the server since the movement component was created
+	UFUNCTION(BlueprintPure, Category = "First Person|Networking")
+		int32 GetNumClientCorrections() const { return NumClientCorrections; }
+
+protected:
+	void UpdateFromCompressedFlags(uint8 Flags) override;
+	bool ClientUpdatePositionAfterServerUpdate() override;
+	void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+	void OnClientCorrectionReceived(class FNetworkPredictionData_Client_Character& ClientData, float TimeStamp, FVector NewLocation, FVector NewVelocity, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) override;
+
+private:
+	int32 NumClientCorrections = 0;
+};
@@ -0,0 +1,15 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+
+// "stat FirstPersonCharacter"
+DECLARE_STATS_GROUP(TEXT("First Person Character"), STATGROUP_FirstPersonCharacter, STATCAT_Advanced);
+
+// Collision queries issued to check if there's room to stand up, sync and async
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Clearance Sweeps"), STAT_FirstPersonClearanceSweeps, STATGROUP_FirstPersonCharacter, FIRSTPERSONCHARACTER_API);
+
+// Off by default. Enable it with -csvCategories=FirstPersonCharacter or "csv.Category FirstPersonCharacter 1" while capturing, also in Test builds
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(FIRSTPERSONCHARACTER_API, FirstPersonCharacter);
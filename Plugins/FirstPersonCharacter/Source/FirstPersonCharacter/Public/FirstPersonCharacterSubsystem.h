@@ -0,0 +1,114 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FPCharacter.h"
+#include "FirstPersonCharacterSubsystem.generated.h"
+
+/**
+ * Updates all first person characters of a world in one batch.
+ * Procedural head bob state is kept in contiguous arrays and evaluated 4 characters at a time.
+ * Characters that opt into the batched update don't tick on their own. Their crouch and walk speed state lives here, one slot per character,
+ * is stepped in parallel, and only written to their components when it changes.
+ * Characters with significance enabled are scored by distance and visibility to the local players, which scales their update rate.
+ * Also keeps track of the baked surface maps of the loaded levels
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonCharacterSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// Returns a handle to pass back to UnregisterHeadBob
+	int32 RegisterHeadBob(class AFPCharacter* Character);
+	void UnregisterHeadBob(int32 Handle);
+
+	// Returns a handle to pass back to UnregisterBatchedUpdate. The character's current locomotion state and settings are copied into the slot
+	int32 RegisterBatchedUpdate(AFPCharacter* Character);
+	void UnregisterBatchedUpdate(int32 Handle);
+
+	// Resumes the update of a resting character with its latest intents
+	void WakeBatchedUpdate(int32 Handle, bool bCrouchIntent, bool bRunIntent);
+	void SetBatchedTickInterval(int32 Handle, float TickInterval);
+	FFirstPersonLocomotionState GetBatchedLocomotion(int32 Handle) const;
+
+	void RegisterSignificance(AFPCharacter* Character);
+	void UnregisterSignificance(AFPCharacter* Character);
+
+	void RegisterSurfaceMap(class AFirstPersonSurfaceMapActor* SurfaceMapActor);
+	void UnregisterSurfaceMap(AFirstPersonSurfaceMapActor* SurfaceMapActor);
+
+	// Looks up the surface below a location in the baked surface maps. Returns false if no loaded map covers it
+	bool SampleSurfaceMaps(const FVector& Location, const UPhysicalMaterial*& OutSurface) const;
+
+	// The surfaces of all loaded surface maps, i.e. what can be walked on in the loaded levels
+	void GetSurfaceMapSurfaces(TArray<const UPhysicalMaterial*>& OutSurfaces) const;
+
+	// Broadcast when a surface map streams in or out
+	DECLARE_MULTICAST_DELEGATE(FOnSurfaceMapsChanged);
+	FOnSurfaceMapsChanged OnSurfaceMapsChanged;
+
+	// FTickableGameObject
+	void Tick(float DeltaTime) override;
+	ETickableTickType GetTickableTickType() const override;
+	bool IsTickable() const override;
+	TStatId GetStatId() const override;
+	UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	void UpdateLocomotionBatch(float DeltaTime);
+	void SetBatchedLocomotion(int32 Handle, const FFirstPersonLocomotionState& State);
+	void UpdateSignificance(float DeltaTime);
+
+	void ResizeHeadBobArrays(int32 NewNum);
+	void GatherHeadBob(float DeltaTime);
+	void EvaluateHeadBob();
+	void ApplyHeadBob();
+
+	template <typename T>
+	using TSimdArray = TArray<T, TAlignedHeapAllocator<16>>;
+
+	UPROPERTY(Transient)
+		TArray<AFPCharacter*> HeadBobCharacters;
+
+	UPROPERTY(Transient)
+		TArray<AFirstPersonSurfaceMapActor*> SurfaceMaps;
+
+	UPROPERTY(Transient)
+		TArray<AFPCharacter*> BatchedCharacters;
+
+	// Struct-of-arrays locomotion state of the batched characters, indexed by their handle. Sized on registration, so steady state never allocates
+	TArray<ECrouchPhase> CrouchPhases;
+	TArray<float> CurrentWalkSpeeds;
+	TArray<float> MaxWalkSpeeds;
+	TArray<float> CrouchHalfHeights;
+	TArray<FVector> CameraLocations;
+	TArray<FFirstPersonLocomotionParams> LocomotionParams;
+	TArray<uint8> LocomotionFlags;
+	TArray<float> PendingDeltaTimes;
+	TArray<float> TickIntervals;
+
+	// Handles of the characters stepped this frame
+	TArray<int32> DueHandles;
+
+	UPROPERTY(Transient)
+		TArray<AFPCharacter*> SignificanceCharacters;
+
+	// Local players' view locations, kept around so scoring doesn't allocate
+	TArray<FVector> ViewLocations;
+	float TimeUntilSignificanceUpdate = 0.0f;
+
+	// Struct-of-arrays head bob state, padded to a multiple of 4 entries
+	TSimdArray<float> BobPhases;
+	TSimdArray<float> BreathingPhases;
+	TSimdArray<float> BobWeights;
+	TSimdArray<float> TargetBobWeights;
+	TSimdArray<float> BlendAlphas;
+	TSimdArray<float> VerticalAmplitudes;
+	TSimdArray<float> LateralAmplitudes;
+	TSimdArray<float> BreathingAmplitudes;
+	TSimdArray<float> VerticalOffsets;
+	TSimdArray<float> LateralOffsets;
+};
@@ -0,0 +1,59 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Trace/Config.h"
+
+#if UE_TRACE_ENABLED && !UE_BUILD_SHIPPING
+#define FIRSTPERSONCHARACTER_TRACE_ENABLED 1
+#else
+#define FIRSTPERSONCHARACTER_TRACE_ENABLED 0
+#endif
+
+#if FIRSTPERSONCHARACTER_TRACE_ENABLED
+
+/**
+ * Per-character timeline events for Unreal Insights, in the "FirstPersonCharacter" trace channel (-trace=FirstPersonCharacter).
+ * Every event carries a timestamp and the unique ID of the character. Nothing is gathered or written while the channel is off
+ */
+struct FIRSTPERSONCHARACTER_API FFirstPersonCharacterTrace
+{
+	static bool IsEnabled();
+
+	static void OutputCrouchPhase(uint32 CharacterId, uint8 NewCrouchPhase);
+	static void OutputWalkSpeed(uint32 CharacterId, float MaxWalkSpeed);
+	static void OutputStride(uint32 CharacterId, float StrideLength, float TimeSinceStep);
+	static void OutputFootstep(uint32 CharacterId, const UObject* Surface, const UObject* Sound, bool bBakedSurface);
+	static void OutputClearanceSweep(uint32 CharacterId, bool bBlocked, bool bAsync);
+	static void OutputShakeTransition(uint32 CharacterId, uint8 LocomotionState);
+};
+
+#define TRACE_FIRSTPERSON_CROUCH_PHASE(Character, CrouchPhase) \
+	FFirstPersonCharacterTrace::OutputCrouchPhase((Character)->GetUniqueID(), static_cast<uint8>(CrouchPhase))
+
+#define TRACE_FIRSTPERSON_WALK_SPEED(Character, MaxWalkSpeed) \
+	FFirstPersonCharacterTrace::OutputWalkSpeed((Character)->GetUniqueID(), MaxWalkSpeed)
+
+#define TRACE_FIRSTPERSON_STRIDE(Character, Stride, TimeSinceStep) \
+	FFirstPersonCharacterTrace::OutputStride((Character)->GetUniqueID(), Stride, TimeSinceStep)
+
+#define TRACE_FIRSTPERSON_FOOTSTEP(Character, Surface, Sound, bBakedSurface) \
+	FFirstPersonCharacterTrace::OutputFootstep((Character)->GetUniqueID(), Surface, Sound, bBakedSurface)
+
+#define TRACE_FIRSTPERSON_CLEARANCE_SWEEP(CharacterId, bBlocked, bAsync) \
+	FFirstPersonCharacterTrace::OutputClearanceSweep(CharacterId, bBlocked, bAsync)
+
+#define TRACE_FIRSTPERSON_SHAKE_TRANSITION(Character, LocomotionState) \
+	FFirstPersonCharacterTrace::OutputShakeTransition((Character)->GetUniqueID(), static_cast<uint8>(LocomotionState))
+
+#else
+
+#define TRACE_FIRSTPERSON_CROUCH_PHASE(Character, CrouchPhase)
+#define TRACE_FIRSTPERSON_WALK_SPEED(Character, MaxWalkSpeed)
+#define TRACE_FIRSTPERSON_STRIDE(Character, Stride, TimeSinceStep)
+#define TRACE_FIRSTPERSON_FOOTSTEP(Character, Surface, Sound, bBakedSurface)
+#define TRACE_FIRSTPERSON_CLEARANCE_SWEEP(CharacterId, bBlocked, bAsync)
+#define TRACE_FIRSTPERSON_SHAKE_TRANSITION(Character, LocomotionState)
+
+#endif
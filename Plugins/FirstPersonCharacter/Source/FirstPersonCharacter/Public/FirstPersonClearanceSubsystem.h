@@ -0,0 +1,63 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "FirstPersonClearanceSubsystem.generated.h"
+
+/**
+ * Answers "is there room to stand up?" for every character in the world with asynchronous sweeps.
+ * Sweeps requested during a frame run in the engine's async trace batch and their results are served from a cache on the next frame.
+ * Until a recent result is available, the answer is conservatively "blocked". Checks that can't wait a frame sweep right away
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonClearanceSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Returns the latest sweep result for this requester and queues a new sweep if none is in flight
+	bool IsBlocked(const AActor* Requester, const FVector& Start, const FVector& End, float Radius, ECollisionChannel TraceChannel,
+		const FCollisionQueryParams& QueryParams, const FCollisionResponseParams& ResponseParams);
+
+	// Sweeps right away, for answers that can't come from last frame
+	bool IsBlockedNow(const AActor* Requester, const FVector& Start, const FVector& End, float Radius, ECollisionChannel TraceChannel,
+		const FCollisionQueryParams& QueryParams, const FCollisionResponseParams& ResponseParams);
+
+	// Drops the cached result of a requester, e.g. when it's destroyed
+	void Forget(const AActor* Requester);
+
+	// A hit blocks standing up unless the other object simulates physics (we can push it away)
+	static bool IsBlockingHit(const FHitResult& Hit);
+
+	// Sync and async
+	UFUNCTION(BlueprintPure, Category = "First Person|Clearance")
+		int32 GetNumSweepsIssued() const { return NumSweepsIssued; }
+
+	// Answers that came from a stored sweep result, not counting the "blocked" answers given while there's no recent result
+	UFUNCTION(BlueprintPure, Category = "First Person|Clearance")
+		int32 GetNumServedFromCache() const { return NumServedFromCache; }
+
+private:
+	struct FClearanceEntry
+	{
+		uint64 RequestFrame = 0;
+		uint64 ResultRequestFrame = 0;
+		bool bPending = false;
+		bool bHasResult = false;
+		bool bBlocked = true;
+	};
+
+	void OnSweepCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+	void PruneEntries();
+
+	// Keyed by the requester's unique ID, which is also passed to the sweep as its user data
+	TMap<uint32, FClearanceEntry> Entries;
+	uint64 LastPruneFrame = 0;
+
+	FTraceDelegate SweepDelegate;
+
+	int32 NumSweepsIssued = 0;
+	int32 NumServedFromCache = 0;
+};
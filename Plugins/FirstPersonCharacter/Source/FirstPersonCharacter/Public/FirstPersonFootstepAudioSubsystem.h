@@ -0,0 +1,78 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FirstPersonFootstepAudioSubsystem.generated.h"
+
+/**
+ * Plays the footsteps of every character in the world under one voice budget.
+ * Footsteps requested during a frame are scored by volume and distance to the nearest listener at the end of the frame.
+ * Inaudible ones are culled and far ones close to each other are merged before any audio component is touched, the rest play on pooled audio components.
+ * Also streams in the sounds of the footstep data assets in use, once per world no matter how many characters share them
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonFootstepAudioSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// Queues a footstep for this frame. It starts from the beginning of the sound at the end of the frame, whenever during the frame it was queued
+	void PlayFootstep(const class APawn* Instigator, class USoundBase* Sound, const FVector& Location, float VolumeMultiplier);
+
+	// Starts loading the sounds of a footstep mapping asynchronously, unless they're already loaded or on their way
+	void LoadFootstepSounds(const class UFirstPersonFootstepData* Mapping);
+
+	// Same for sounds that don't come with their data asset, e.g. the sounds of a footstep bank entry
+	void LoadFootstepSounds(const FSoftObjectPath& Source, TArrayView<const TSoftObjectPtr<USoundBase>> Sounds);
+
+	UFUNCTION(BlueprintPure, Category = "First Person|Footsteps")
+		int32 GetNumFootstepsPlayed() const { return NumPlayed; }
+
+	UFUNCTION(BlueprintPure, Category = "First Person|Footsteps")
+		int32 GetNumFootstepsCulled() const { return NumCulled; }
+
+	UFUNCTION(BlueprintPure, Category = "First Person|Footsteps")
+		int32 GetNumFootstepsMerged() const { return NumMerged; }
+
+	bool ShouldCreateSubsystem(UObject* Outer) const override;
+	void Deinitialize() override;
+
+	// FTickableGameObject
+	void Tick(float DeltaTime) override;
+	ETickableTickType GetTickableTickType() const override;
+	bool IsTickable() const override;
+	TStatId GetStatId() const override;
+	UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	struct FFootstepRequest
+	{
+		USoundBase* Sound = nullptr;
+		FVector Location = FVector::ZeroVector;
+		float VolumeMultiplier = 1.0f;
+		float Priority = 0.0f;
+		float ListenerDistance = 0.0f;
+		bool bLocal = false;
+	};
+
+	void GatherListeners();
+	bool ScoreRequest(FFootstepRequest& Request) const;
+	class UAudioComponent* GetFreeVoice(int32 MaxVoices);
+
+	// Only valid during a frame, the sounds are referenced by the footstep data assets
+	TArray<FFootstepRequest> Requests;
+	TArray<FFootstepRequest*> AcceptedRequests;
+	TArray<FVector> ListenerLocations;
+
+	UPROPERTY(Transient)
+		TArray<UAudioComponent*> Voices;
+
+	// Keeps the sounds of each mapping loaded for as long as the world exists
+	TMap<FSoftObjectPath, TSharedPtr<struct FStreamableHandle>> FootstepSoundHandles;
+
+	int32 NumPlayed = 0;
+	int32 NumCulled = 0;
+	int32 NumMerged = 0;
+};
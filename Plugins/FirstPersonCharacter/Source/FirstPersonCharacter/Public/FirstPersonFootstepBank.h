@@ -0,0 +1,71 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Engine/DataAsset.h"
+#include "FirstPersonFootstepBank.generated.h"
+
+class UPhysicalMaterial;
+class USoundBase;
+
+USTRUCT()
+struct FFirstPersonFootstepBankEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		UPhysicalMaterial* PhysicalMaterial = nullptr;
+
+	// The footstep data asset this entry was cooked from
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		FSoftObjectPath Source;
+
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		float WalkStride = 160.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		float RunStride = 90.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		float CrouchStride = 120.0f;
+
+	// Range in the bank's Sounds
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		int32 FirstSound = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		int32 NumSounds = 0;
+};
+
+/**
+ * All footstep data assets of the project cooked into one asset by the FirstPersonFootstepBank commandlet.
+ * The entries are validated when cooking, and the sounds of all entries are packed one after another.
+ * Characters that use a bank build their footstep table from it without loading or checking the individual data assets
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonFootstepBank : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	const TArray<FFirstPersonFootstepBankEntry>& GetEntries() const { return Entries; }
+	const TArray<TSoftObjectPtr<USoundBase>>& GetSounds() const { return Sounds; }
+
+	// Entry index of each EPhysicalSurface, INDEX_NONE if no entry has that surface type
+	const TArray<int32>& GetSurfaceTypeToEntry() const { return SurfaceTypeToEntry; }
+
+#if WITH_EDITOR
+	// Validates the mappings and replaces the contents of the bank with the valid ones. Returns the number of errors
+	int32 Cook(const TArray<class UFirstPersonFootstepData*>& Mappings);
+#endif
+
+protected:
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		TArray<FFirstPersonFootstepBankEntry> Entries;
+
+	UPROPERTY(VisibleAnywhere, Category = "Footstep Bank")
+		TArray<TSoftObjectPtr<USoundBase>> Sounds;
+
+	UPROPERTY()
+		TArray<int32> SurfaceTypeToEntry;
+};
@@ -0,0 +1,22 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "FirstPersonFootstepBankCommandlet.generated.h"
+
+/**
+ * Validates every UFirstPersonFootstepData in the project and cooks them into a single UFirstPersonFootstepBank.
+ * Fails when a data asset has no physical material, no sounds, or a physical material that another data asset already maps.
+ * Usage: UE4Editor-Cmd <Project> -run=FirstPersonFootstepBank -Bank=/Game/Footsteps/FootstepBank [-Paths=/Game/Footsteps+/Game/Other] -unattended -nullrhi
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonFootstepBankCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UFirstPersonFootstepBankCommandlet();
+
+	int32 Main(const FString& Params) override;
+};
@@ -7,19 +7,25 @@
 #include "FirstPersonFootstepData.generated.h"
 
 /**
- * Stores an array of sounds and a reference to a PhysicalMaterial
+ * Stores an array of sounds and a reference to a PhysicalMaterial.
+ * The sounds are soft references in the "Footsteps" asset bundle, so they're only loaded for the surfaces a level actually uses
  */
 UCLASS(BlueprintType)
 class FIRSTPERSONCHARACTER_API UFirstPersonFootstepData : public UPrimaryDataAsset
 {
 	GENERATED_BODY()
 
+	friend struct FFirstPersonCharacterTestAccess;
+
 public:
+	// The asset bundle of the footstep sounds
+	static const FName SoundBundle;
+
 	UFUNCTION(BlueprintPure, Category = "Footstep Data")
 	UPhysicalMaterial* GetPhysicalMaterial() const { return PhysicalMaterial; }
 
 	UFUNCTION(BlueprintPure, Category = "Footstep Data")
-	TArray<USoundBase*> GetFootstepSounds() const { return Sounds; }
+	const TArray<TSoftObjectPtr<USoundBase>>& GetFootstepSounds() const { return Sounds; }
 	
 	UFUNCTION(BlueprintPure, Category = "Footstep Data")
 	float GetFootstepStride_Walk() const { return WalkStride; }
@@ -46,6 +52,6 @@ protected:
 	UPROPERTY(EditInstanceOnly, Category = "Footstep", meta = (EditCondition = "bEnableFootsteps"))
 	float RunStride = 90.0f;
 		
-	UPROPERTY(EditDefaultsOnly, Category = "Properties")
-	TArray<USoundBase*> Sounds;
+	UPROPERTY(EditDefaultsOnly, Category = "Properties", meta = (AssetBundles = "Footsteps"))
+	TArray<TSoftObjectPtr<USoundBase>> Sounds;
 };
@@ -0,0 +1,72 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UFirstPersonFootstepBank;
+class UFirstPersonFootstepData;
+class UPhysicalMaterial;
+class USoundBase;
+
+enum class EFootstepStance : uint8
+{
+	Walk,
+	Run,
+	Crouch,
+
+	Num
+};
+
+/**
+ * Flat lookup table compiled from the footstep data assets of a character.
+ * Finding the mapping of a surface is a single hash lookup, and sounds are picked from a no-repeat shuffle bag without allocating
+ */
+class FIRSTPERSONCHARACTER_API FFirstPersonFootstepTable
+{
+public:
+	void Build(const TArray<UFirstPersonFootstepData*>& Mappings);
+
+	// Cooked banks are already validated and indexed, so this only copies them
+	void Build(const UFirstPersonFootstepBank& Bank);
+	void Reset();
+
+	// Returns INDEX_NONE if there is no mapping for this surface
+	int32 FindEntry(const UPhysicalMaterial* Surface) const;
+
+	float GetStride(int32 Entry, EFootstepStance Stance) const;
+	// Null for entries built from a bank
+	UFirstPersonFootstepData* GetMapping(int32 Entry) const;
+	TArrayView<const TSoftObjectPtr<USoundBase>> GetSounds(int32 Entry) const;
+	const FSoftObjectPath& GetSource(int32 Entry) const;
+
+	// Skips the sounds that aren't loaded yet, without using up their turn. Returns nullptr if none of them is loaded
+	USoundBase* PickSound(int32 Entry, FRandomStream& Random);
+
+private:
+	struct FEntry
+	{
+		UFirstPersonFootstepData* Mapping;
+		FSoftObjectPath Source;
+		float Strides[static_cast<int32>(EFootstepStance::Num)];
+		int32 FirstSound;
+		int32 NumSounds;
+		int32 BagCursor;
+		int32 LastSound;
+	};
+
+	void Shuffle(FEntry& Entry, FRandomStream& Random);
+
+	TMap<const UPhysicalMaterial*, int32> MaterialToEntry;
+
+	// Fallback for physical materials without a mapping of their own, indexed by EPhysicalSurface
+	TArray<int32> SurfaceTypeToEntry;
+
+	TArray<FEntry> Entries;
+
+	// The sounds of all the entries, packed one after another. They're loaded on demand
+	TArray<TSoftObjectPtr<USoundBase>> Sounds;
+
+	// Play order of each entry's sounds, parallel to Sounds
+	TArray<int32> ShuffleBag;
+};
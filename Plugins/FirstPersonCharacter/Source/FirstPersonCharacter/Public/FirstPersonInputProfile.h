@@ -0,0 +1,22 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "GameFramework/PlayerInput.h"
+
+/**
+ * A set of key bindings that is applied to a single player's PlayerInput.
+ * Unlike editing UInputSettings, this never writes to the input config or touches the project's key mappings
+ */
+struct FIRSTPERSONCHARACTER_API FFirstPersonInputProfile
+{
+	TArray<FInputActionKeyMapping> ActionMappings;
+	TArray<FInputAxisKeyMapping> AxisMappings;
+
+	// The plugin's default bindings, built once per process
+	static const FFirstPersonInputProfile& GetDefault();
+
+	// Replaces the player's bindings of every action and axis in this profile.
+	// With bKeepExistingBindings, actions and axes that the player already has bindings for are left alone
+	void ApplyTo(UPlayerInput* PlayerInput, bool bKeepExistingBindings) const;
+};
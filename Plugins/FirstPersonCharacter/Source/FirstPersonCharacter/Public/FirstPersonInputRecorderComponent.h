@@ -0,0 +1,103 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Components/ActorComponent.h"
+#include "FirstPersonInputRecorderComponent.generated.h"
+
+// Everything that reaches the input handlers of a first person character
+enum class EFirstPersonInputEvent : uint8
+{
+	MoveForward,
+	MoveRight,
+	Turn,
+	LookUp,
+	JumpPressed,
+	JumpReleased,
+	RunPressed,
+	RunReleased,
+	CrouchPressed,
+	CrouchReleased,
+
+	NumAxes = JumpPressed
+};
+
+/**
+ * Records the input stream of a first person character into a binary file and replays it frame by frame, each frame with the time step it was recorded with.
+ * The file is written and read frame by frame while playing. Axes are only stored when they change, so an idle frame takes little more than its time step.
+ * Replays start from the recorded location, rotation and footstep seed, so they produce the same footstep, crouch and shake events on every run.
+ * Characters create one for the first local player when the game is started with -FPRecord=File or -FPReplay=File
+ */
+UCLASS(ClassGroup = "First Person", meta = (BlueprintSpawnableComponent))
+class FIRSTPERSONCHARACTER_API UFirstPersonInputRecorderComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFirstPersonInputRecorderComponent();
+
+	UFUNCTION(BlueprintCallable, Category = "First Person|Input Recording")
+		bool StartRecording(const FString& FileName);
+
+	UFUNCTION(BlueprintCallable, Category = "First Person|Input Recording")
+		bool StartReplay(const FString& FileName);
+
+	// Stops recording or replaying, and closes the file
+	UFUNCTION(BlueprintCallable, Category = "First Person|Input Recording")
+		void Stop();
+
+	UFUNCTION(BlueprintPure, Category = "First Person|Input Recording")
+		bool IsRecording() const { return Writer.IsValid(); }
+
+	UFUNCTION(BlueprintPure, Category = "First Person|Input Recording")
+		bool IsReplaying() const { return Reader.IsValid(); }
+
+	// Called by the input handlers of the character, does nothing unless recording
+	void Record(EFirstPersonInputEvent Event, float Value = 0.0f);
+
+	// Starts recording or replaying if the command line asks for it. Returns false if it doesn't
+	bool StartFromCommandLine();
+
+	static bool IsRequestedOnCommandLine();
+
+	UPROPERTY(EditAnywhere, Category = "Input Recording", meta = (ToolTip = "Quit the game when a replay started from the command line has finished"))
+		bool bQuitAfterReplay = true;
+
+protected:
+	void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	void EndPlay(EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	struct FHeader
+	{
+		FVector Location;
+		FRotator ActorRotation;
+		FRotator ControlRotation;
+		int32 FootstepSeed = 0;
+	};
+
+	void SerializeHeader(FArchive& Ar, FHeader& Header);
+	void WriteFrame();
+
+	// Reads the next frame and makes the engine step the coming frame with its recorded time step
+	bool ReadFrame();
+	void ReplayFrame();
+	class AFPCharacter* GetCharacter() const;
+
+	TUniquePtr<FArchive> Writer;
+	TUniquePtr<FArchive> Reader;
+
+	// This frame's events while recording, the next frame's while replaying
+	TArray<TPair<EFirstPersonInputEvent, float>> PendingEvents;
+
+	// Ticks before the recorder while recording, after it while replaying
+	TWeakObjectPtr<AController> PrerequisiteController;
+
+	// Last recorded or replayed value of each axis
+	float AxisValues[(int32)EFirstPersonInputEvent::NumAxes] = {};
+
+	int32 NumFrames = 0;
+	bool bStartedFromCommandLine = false;
+	bool bRestoreFixedTimeStep = false;
+	double PreviousFixedDeltaTime = 0.0;
+};
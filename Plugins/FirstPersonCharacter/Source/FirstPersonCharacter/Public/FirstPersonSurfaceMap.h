@@ -0,0 +1,54 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Engine/DataAsset.h"
+#include "FirstPersonSurfaceMap.generated.h"
+
+/**
+ * A top-down grid of the walkable surfaces of a level, baked in the editor.
+ * Each cell stores the physical material and height of the highest static walkable floor, so footsteps can look up the surface without a physics query
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonSurfaceMap : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// Finds the baked surface below a location. Returns false if the location is outside the grid, above a movable floor or too far from the baked height
+	bool Sample(const FVector& Location, float MaxHeightDifference, const UPhysicalMaterial*& OutSurface) const;
+
+	bool IsEmpty() const { return Cells.Num() == 0; }
+
+	const TArray<UPhysicalMaterial*>& GetSurfaces() const { return Surfaces; }
+
+#if WITH_EDITOR
+	// Rasterizes the walkable geometry inside Bounds by tracing down the center of each cell
+	void Bake(UWorld* World, const FBox& Bounds, float NewCellSize, ECollisionChannel TraceChannel);
+#endif
+
+protected:
+	UPROPERTY(VisibleAnywhere, Category = "Surface Map")
+		FVector Origin;
+
+	UPROPERTY(VisibleAnywhere, Category = "Surface Map")
+		float CellSize = 50.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Surface Map")
+		int32 SizeX = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "Surface Map")
+		int32 SizeY = 0;
+
+	// The physical materials referenced by the cells
+	UPROPERTY(VisibleAnywhere, Category = "Surface Map")
+		TArray<UPhysicalMaterial*> Surfaces;
+
+	// Index into Surfaces plus one. Zero means no static floor (or no physical material), use a trace instead
+	UPROPERTY()
+		TArray<uint8> Cells;
+
+	// Floor height of each cell, in whole units relative to Origin.Z
+	UPROPERTY()
+		TArray<int16> Heights;
+};
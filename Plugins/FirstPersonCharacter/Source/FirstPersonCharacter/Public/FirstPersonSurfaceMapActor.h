@@ -0,0 +1,48 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "FirstPersonSurfaceMapActor.generated.h"
+
+/**
+ * Place one in a level (or streaming level) to give its footsteps a baked surface map.
+ * The map is registered while the actor's level is loaded, so it streams in and out with the level
+ */
+UCLASS(HideCategories = (Rendering, Replication, Input, Actor, LOD, Cooking))
+class FIRSTPERSONCHARACTER_API AFirstPersonSurfaceMapActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AFirstPersonSurfaceMapActor();
+
+	const class UFirstPersonSurfaceMap* GetSurfaceMap() const { return SurfaceMap; }
+
+#if WITH_EDITOR
+	// Bakes the surface map of the area covered by the bounds. Creates the asset next to the map if there is none yet
+	UFUNCTION(CallInEditor, Category = "Surface Map")
+		void BakeSurfaceMap();
+#endif
+
+protected:
+	void BeginPlay() override;
+	void EndPlay(EEndPlayReason::Type EndPlayReason) override;
+
+	UPROPERTY(VisibleDefaultsOnly, Category = "Components")
+		class UBoxComponent* BoundsComponent;
+
+	UPROPERTY(EditInstanceOnly, Category = "Surface Map")
+		UFirstPersonSurfaceMap* SurfaceMap;
+
+	UPROPERTY(EditInstanceOnly, Category = "Surface Map", meta = (ClampMin=10.0f, ClampMax=1000.0f, ToolTip = "The size of a grid cell. Smaller cells follow surface borders more closely, but use more memory"))
+		float CellSize = 50.0f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Surface Map", meta = (ClampMin=0.0f, ToolTip = "How far a character's feet may be from the baked floor height before falling back to a trace"))
+		float MaxHeightDifference = 30.0f;
+
+	UPROPERTY(EditInstanceOnly, Category = "Surface Map")
+		TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+	friend class UFirstPersonCharacterSubsystem;
+};
@@ -0,0 +1,24 @@
+// Copyright Ali El Saleh, 2020
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "FirstPersonSurfaceMapCommandlet.generated.h"
+
+/**
+ * Bakes the surface maps of every AFirstPersonSurfaceMapActor in the given maps and saves them next to the maps.
+ * Usage: UE4Editor-Cmd <Project> -run=FirstPersonSurfaceMap -Maps=/Game/Maps/MapA+/Game/Maps/MapB
+ */
+UCLASS()
+class FIRSTPERSONCHARACTER_API UFirstPersonSurfaceMapCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UFirstPersonSurfaceMapCommandlet();
+
+	int32 Main(const FString& Params) override;
+
+private:
+	bool BakeMap(const FString& MapName);
+};